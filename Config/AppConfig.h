@@ -0,0 +1,376 @@
+/*
+  Copyright 2013  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaims all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/** \file
+ *  \brief Application Configuration Header File
+ *
+ *  This is a header file which is used to configure some of
+ *  the application's compile time options, as an alternative to
+ *  specifying the compile time constants supplied through a
+ *  makefile or build system. Every token may be overridden from
+ *  the makefile, e.g. "make TOUCH_OPTS=-DTOUCH_FILTER=0".
+ */
+
+#ifndef _APP_CONFIG_H_
+#define _APP_CONFIG_H_
+
+	/* USB Tokens: */
+		/** Polling interval in milliseconds of the HID IN endpoint. */
+		#ifndef MOUSE_POLLING_INTERVAL_MS
+			#define MOUSE_POLLING_INTERVAL_MS    1
+		#endif
+
+		/** Number of hardware banks of the HID IN endpoint, 1 or 2. With two banks a new report can
+		 *  be staged while the previous one still waits for the host.
+		 */
+		#ifndef MOUSE_EPBANKS
+			#define MOUSE_EPBANKS                2
+		#endif
+
+		/** Default HID idle rate in milliseconds, after which an unchanged report is repeated. Zero
+		 *  sends reports only on change; the host may override it with SET_IDLE.
+		 */
+		#ifndef MOUSE_IDLE_MS
+			#define MOUSE_IDLE_MS                0
+		#endif
+
+		/** Size in bytes of the HID IN endpoint, at most 64. It must hold the whole touch report. */
+		#ifndef MOUSE_EPSIZE
+			#define MOUSE_EPSIZE                 (TOUCH_REPORT_BATCH ? 64 : 16)
+		#endif
+
+		/** Bus current in milliamperes declared in the configuration descriptor: the controller at
+		 *  8 MHz plus the panel drive through the lowest plate resistance.
+		 */
+		#ifndef USB_MAX_POWER_MA
+			#define USB_MAX_POWER_MA             50
+		#endif
+
+		/** Number of processed touch samples queued for the HID report, a power of two. */
+		#ifndef TOUCH_REPORT_QUEUE
+			#define TOUCH_REPORT_QUEUE           4
+		#endif
+
+	/* Raw Stream Tokens: */
+		/** Non-zero to add a vendor interface streaming the raw readouts of every scan frame over a
+		 *  bulk IN endpoint, started and stopped by a vendor request.
+		 */
+		#ifndef TOUCH_RAW_STREAM
+			#define TOUCH_RAW_STREAM             1
+		#endif
+
+		/** Number of raw samples buffered for the stream, a power of two. */
+		#ifndef RAW_STREAM_QUEUE
+			#define RAW_STREAM_QUEUE             32
+		#endif
+
+		/** Longest delay in milliseconds before queued raw samples are sent in a partial packet. */
+		#ifndef RAW_STREAM_FLUSH_MS
+			#define RAW_STREAM_FLUSH_MS          4
+		#endif
+
+	/* Scan Engine Tokens: */
+		/** Number of resistive panels scanned, 1 or 2. Each panel has its own HID interface, and the
+		 *  panel profile gives the wiring of both.
+		 */
+		#ifndef TOUCH_PANELS
+			#define TOUCH_PANELS                 1
+		#endif
+
+		/** Panel profile, selecting \c Config/Panels/<name>.h. The profile gives the pins, ADC
+		 *  channels and mounting orientation of every panel; see panel.h.
+		 */
+		#ifndef PANEL_PROFILE
+			#define PANEL_PROFILE                reference
+		#endif
+
+		/** Extra coordinate bits gained by oversampling, 0 to 2. Each X/Y readout accumulates
+		 *  4^TOUCH_OVERSAMPLE_BITS conversions and is decimated to 10 + TOUCH_OVERSAMPLE_BITS bits.
+		 */
+		#ifndef TOUCH_OVERSAMPLE_BITS
+			#define TOUCH_OVERSAMPLE_BITS        0
+		#endif
+
+		/** Fastest ADC clock in Hz the prescaler planner may pick for the scan engine. The datasheet
+		 *  specifies 50 to 200 kHz for full 10-bit accuracy.
+		 */
+		#ifndef TOUCH_ADC_CLOCK_HZ
+			#define TOUCH_ADC_CLOCK_HZ           200000
+		#endif
+
+		/** Settle time in microseconds the panel gets after switching to a coordinate phase, before
+		 *  its first used conversion. Rounded up to whole conversions, at least one.
+		 */
+		#ifndef TOUCH_SETTLE_XY_US
+			#define TOUCH_SETTLE_XY_US           100
+		#endif
+
+		/** Settle time in microseconds after switching to a standby phase, which senses through the
+		 *  touch resistance and so settles slower.
+		 */
+		#ifndef TOUCH_SETTLE_STBY_US
+			#define TOUCH_SETTLE_STBY_US         200
+		#endif
+
+		/** Non-zero to stop scanning once the panel has been without any contact for
+		 *  \ref TOUCH_IDLE_MS, leaving the analog comparator to detect the next one.
+		 */
+		#ifndef TOUCH_IDLE_DETECT
+			#define TOUCH_IDLE_DETECT            1
+		#endif
+
+		/** Time in milliseconds without contact after which scanning stops. */
+		#ifndef TOUCH_IDLE_MS
+			#define TOUCH_IDLE_MS                20
+		#endif
+
+		/** Interval in milliseconds of the single scan frames run while idle, as a fallback to the
+		 *  analog comparator.
+		 */
+		#ifndef TOUCH_IDLE_POLL_MS
+			#define TOUCH_IDLE_POLL_MS           50
+		#endif
+
+		/** Non-zero to support measuring the panel's settle curves on request and switching to the
+		 *  shortest settle times they allow.
+		 */
+		#ifndef TOUCH_SETTLE_MEASURE
+			#define TOUCH_SETTLE_MEASURE         1
+		#endif
+
+		/** Largest distance in 10-bit counts from the final value a measured conversion may have to
+		 *  count as settled.
+		 */
+		#ifndef TOUCH_SETTLE_TOLERANCE
+			#define TOUCH_SETTLE_TOLERANCE       2
+		#endif
+
+	/* Report Tokens: */
+		/** Width of the panel's active area in 0.1 mm, reported as the X physical range. */
+		#ifndef TOUCH_PHYSICAL_WIDTH
+			#define TOUCH_PHYSICAL_WIDTH         1550
+		#endif
+
+		/** Height of the panel's active area in 0.1 mm, reported as the Y physical range. */
+		#ifndef TOUCH_PHYSICAL_HEIGHT
+			#define TOUCH_PHYSICAL_HEIGHT        870
+		#endif
+
+		/** Movement in reported X/Y counts that must be exceeded before a moved touch is reported. */
+		#ifndef TOUCH_DEADBAND
+			#define TOUCH_DEADBAND               1
+		#endif
+
+		/** Number of coordinate samples, up to 8, carried in a vendor defined part of every touch
+		 *  report, each with its scan time, so the host sees every scan rather than the newest
+		 *  one per poll. Zero leaves the batch out of the report.
+		 */
+		#ifndef TOUCH_REPORT_BATCH
+			#define TOUCH_REPORT_BATCH           0
+		#endif
+
+		/** Change in reported tip pressure that must be exceeded before it is reported. */
+		#ifndef TOUCH_Z_DEADBAND
+			#define TOUCH_Z_DEADBAND             16
+		#endif
+
+	/* Pressure Tokens: */
+		/** Touch plate resistance estimate below which a new contact is accepted. Lower values
+		 *  require a firmer press.
+		 */
+		#ifndef TOUCH_Z_PRESS
+			#define TOUCH_Z_PRESS                450
+		#endif
+
+		/** Touch plate resistance estimate above which an accepted contact is released. Must not
+		 *  be below \ref TOUCH_Z_PRESS; the gap is the press/release hysteresis.
+		 */
+		#ifndef TOUCH_Z_RELEASE
+			#define TOUCH_Z_RELEASE              550
+		#endif
+
+		/** Largest reported tip pressure. The pressure is this value minus the plate resistance
+		 *  estimate, clamped at zero.
+		 */
+		#ifndef TOUCH_Z_MAXIMUM
+			#define TOUCH_Z_MAXIMUM              1023
+		#endif
+
+	/* Touch-Down Tokens: */
+		/** Non-zero to report a new contact from its first scan frame when that frame passes the
+		 *  confidence checks below, instead of waiting for a second frame with contact.
+		 */
+		#ifndef TOUCH_FAST_TOUCHDOWN
+			#define TOUCH_FAST_TOUCHDOWN         1
+		#endif
+
+		/** Touch plate resistance estimate below which the first frame of a contact is considered
+		 *  firm enough to report.
+		 */
+		#ifndef TOUCH_Z_CONFIDENT
+			#define TOUCH_Z_CONFIDENT            300
+		#endif
+
+		/** Distance in 10-bit counts from either rail within which a first-frame coordinate is taken
+		 *  for a floating, untouched plate.
+		 */
+		#ifndef TOUCH_RAIL_MARGIN
+			#define TOUCH_RAIL_MARGIN            8
+		#endif
+
+		/** Largest spread in 10-bit counts between the oversampled conversions of a first-frame
+		 *  coordinate, showing the contact was stable during the readout.
+		 */
+		#ifndef TOUCH_SETTLE_SPREAD
+			#define TOUCH_SETTLE_SPREAD          8
+		#endif
+
+	/* Touch Filter Tokens: */
+		/** Non-zero to run the median + adaptive IIR filter on reported coordinates. */
+		#ifndef TOUCH_FILTER
+			#define TOUCH_FILTER                 1
+		#endif
+
+		/** Window length of the spike rejecting median filter, 1 (disabled), 3 or 5 samples. */
+		#ifndef TOUCH_FILTER_MEDIAN
+			#define TOUCH_FILTER_MEDIAN          3
+		#endif
+
+		/** Strongest IIR smoothing, as the right shift applied while the touch is still. */
+		#ifndef TOUCH_FILTER_MAX_SHIFT
+			#define TOUCH_FILTER_MAX_SHIFT       3
+		#endif
+
+		/** Movement in 10-bit ADC counts per frame below which the strongest smoothing is used. Every
+		 *  doubling of the movement above it halves the smoothing.
+		 */
+		#ifndef TOUCH_FILTER_STILL_DELTA
+			#define TOUCH_FILTER_STILL_DELTA     4
+		#endif
+
+	/* Prediction Tokens: */
+		/** Non-zero to extrapolate reported coordinates over the pipeline latency with an alpha-beta
+		 *  motion predictor, run after the touch filter.
+		 */
+		#ifndef TOUCH_PREDICT
+			#define TOUCH_PREDICT                0
+		#endif
+
+		/** Prediction horizon in microseconds, counted from the scan completion. The default covers
+		 *  half a scan, the scan's completion being that much after its average sampling time, plus
+		 *  half a polling interval, the average wait for the host to fetch the report.
+		 */
+		#ifndef TOUCH_PREDICT_HORIZON_US
+			#define TOUCH_PREDICT_HORIZON_US     (TOUCH_SCAN_PERIOD_US / 2 + MOUSE_POLLING_INTERVAL_MS * 500)
+		#endif
+
+		/** Position gain of the predictor as a right shift, 1 for an alpha of 1/2. */
+		#ifndef TOUCH_PREDICT_ALPHA_SHIFT
+			#define TOUCH_PREDICT_ALPHA_SHIFT    1
+		#endif
+
+		/** Velocity gain of the predictor as a right shift, 3 for a beta of 1/8. */
+		#ifndef TOUCH_PREDICT_BETA_SHIFT
+			#define TOUCH_PREDICT_BETA_SHIFT     3
+		#endif
+
+		/** Scan frames the prediction stays off after a touch-down or a detected reversal. */
+		#ifndef TOUCH_PREDICT_HOLD
+			#define TOUCH_PREDICT_HOLD           4
+		#endif
+
+	/* Calibration Tokens: */
+		/** Non-zero to map reported coordinates through the affine calibration stored in EEPROM,
+		 *  set over vendor requests.
+		 */
+		#ifndef TOUCH_CALIBRATION
+			#define TOUCH_CALIBRATION            1
+		#endif
+
+	/* Settings Tokens: */
+		/** Number of EEPROM slots the runtime settings rotate through, each worn by one in this many
+		 *  saves. The pressure, touch-down, dead-band and filter tokens above are only defaults.
+		 */
+		#ifndef TOUCH_SETTINGS_SLOTS
+			#define TOUCH_SETTINGS_SLOTS         8
+		#endif
+
+	/* Power Tokens: */
+		/** Non-zero to sleep the CPU in idle mode whenever the main loop has nothing to do, until the
+		 *  next ADC, start of frame or comparator interrupt. Halting the CPU during conversions also
+		 *  keeps its switching noise off the readouts.
+		 */
+		#ifndef POWER_IDLE_SLEEP
+			#define POWER_IDLE_SLEEP             1
+		#endif
+
+		/** Non-zero to keep the panel biased for touch detection while the bus is suspended and wake
+		 *  the host on a touch, if it has enabled remote wakeup.
+		 */
+		#ifndef POWER_REMOTE_WAKEUP
+			#define POWER_REMOTE_WAKEUP          1
+		#endif
+
+		/** Watchdog period, one of the WDTO_15MS to WDTO_2S values, at which the CPU wakes from power
+		 *  down during suspend to check the panel for a touch.
+		 */
+		#ifndef POWER_SUSPEND_POLL_WDTO
+			#define POWER_SUSPEND_POLL_WDTO      WDTO_30MS
+		#endif
+
+	/* Update Tokens: */
+		/** Milliseconds the device stays detached before resetting into the bootloader. It must
+		 *  outlast the slowest hub status poll, 255 ms for a full speed hub, or the host misses the
+		 *  disconnect and never enumerates the bootloader.
+		 */
+		#ifndef UPDATE_DETACH_MS
+			#define UPDATE_DETACH_MS             300
+		#endif
+
+		/** Bytes of flash added to the CRC of the running image per main loop pass after reset. The
+		 *  whole image takes tens of milliseconds, too long for one pass or a control request.
+		 */
+		#ifndef UPDATE_CRC_CHUNK
+			#define UPDATE_CRC_CHUNK             64
+		#endif
+
+	/* Instrumentation Tokens: */
+		/** Non-zero to gather end-to-end touch latency statistics, read over a vendor request. */
+		#ifndef TOUCH_LATENCY_STATS
+			#define TOUCH_LATENCY_STATS          1
+		#endif
+
+		/** Non-zero to build the CPU utilization profiler, read over a vendor request. It times
+		 *  every ADC interrupt, so leave it off in production images.
+		 */
+		#ifndef TOUCH_PROFILE
+			#define TOUCH_PROFILE                0
+		#endif
+
+	/* Derived Values: */
+		/** Resolution in bits of the reported X/Y coordinates. */
+		#define TOUCH_RESOLUTION_BITS            (10 + TOUCH_OVERSAMPLE_BITS)
+
+		/** Largest reported X/Y coordinate. */
+		#define TOUCH_LOGICAL_MAXIMUM            ((1 << TOUCH_RESOLUTION_BITS) - 1)
+
+#endif
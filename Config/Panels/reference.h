@@ -0,0 +1,48 @@
+/** \file
+ *
+ *  Panel profile of the reference board. The panel is wired to PF4 to PF7, and the second panel of
+ *  dual panel units is wired the same way to PB4 to PB7. Reported X grows towards XR and Y grows
+ *  towards YU.
+ */
+
+#ifndef _PANEL_PROFILE_H_
+#define _PANEL_PROFILE_H_
+
+	/* Panel 0: */
+		#define PANEL0_PORT              PORTF
+		#define PANEL0_DDR               DDRF
+		#define PANEL0_PORT_EXCLUSIVE    1
+
+		#define PANEL0_PIN_YU            7
+		#define PANEL0_PIN_XL            4
+		#define PANEL0_PIN_YD            5
+		#define PANEL0_PIN_XR            6
+
+		#define PANEL0_ADC_YU            7
+		#define PANEL0_ADC_XL            4
+		#define PANEL0_ADC_YD            5
+		#define PANEL0_ADC_XR            6
+
+		#define PANEL0_SWAP_XY           0
+		#define PANEL0_INVERT_X          0
+		#define PANEL0_INVERT_Y          0
+
+	/* Panel 1: */
+		#define PANEL1_PORT              PORTB
+		#define PANEL1_DDR               DDRB
+		#define PANEL1_PORT_EXCLUSIVE    0
+
+		#define PANEL1_PIN_YU            7
+		#define PANEL1_PIN_XL            4
+		#define PANEL1_PIN_YD            5
+		#define PANEL1_PIN_XR            6
+
+		#define PANEL1_ADC_XL            11
+		#define PANEL1_ADC_YD            12
+		#define PANEL1_ADC_XR            13
+
+		#define PANEL1_SWAP_XY           0
+		#define PANEL1_INVERT_X          0
+		#define PANEL1_INVERT_Y          0
+
+#endif
@@ -38,43 +38,106 @@
 
 #include "Descriptors.h"
 
-const USB_Descriptor_HIDReport_Datatype_t PROGMEM MouseReport[] =
+const USB_Descriptor_HIDReport_Datatype_t PROGMEM TouchscreenReport[] =
 {
-	/* Use the HID class driver's standard Mouse report.
-	 *   Min X/Y Axis values: -1
-	 *   Max X/Y Axis values:  1
-	 *   Min physical X/Y Axis values (used to determine resolution): -1
-	 *   Max physical X/Y Axis values (used to determine resolution):  1
-	 *   Buttons: 3
-	 *   Absolute screen coordinates: false
+	/* Single contact Digitizer touch screen report TOUCH_REPORT_ID, see USB_TouchReport_Data_t.
+	 *   Tip Switch, In Range
+	 *   Contact Identifier: 0
+	 *   X/Y: 0 to TOUCH_LOGICAL_MAXIMUM over the panel's physical size in 0.1 mm
+	 *   Tip Pressure: 0 to TOUCH_Z_MAXIMUM
+	 *   Scan Time: 100 us units
+	 *   Contact Count, and a Contact Count Maximum feature of 1
+	 *   With TOUCH_REPORT_BATCH, vendor defined: batch sequence, sample count and
+	 *     TOUCH_REPORT_BATCH X/Y/time delta samples
+	 *
+	 * Vendor defined settings feature report SETTINGS_REPORT_ID, an opaque Settings_t.
 	 */
-	HID_RI_USAGE_PAGE(8, 0x01),
-	HID_RI_USAGE(8, 0x02),
+	HID_RI_USAGE_PAGE(8, 0x0D),
+	HID_RI_USAGE(8, 0x04),
 	HID_RI_COLLECTION(8, 0x01),
-		HID_RI_USAGE(8, 0x01),
-		HID_RI_COLLECTION(8, 0x00),
-			HID_RI_USAGE_PAGE(8, 0x09),
-			HID_RI_USAGE_MINIMUM(8, 0x01),
-			HID_RI_USAGE_MAXIMUM(8, 3),
+		HID_RI_REPORT_ID(8, TOUCH_REPORT_ID),
+		HID_RI_USAGE(8, 0x22),
+		HID_RI_COLLECTION(8, 0x02),
+			HID_RI_USAGE(8, 0x42),
+			HID_RI_USAGE(8, 0x32),
 			HID_RI_LOGICAL_MINIMUM(8, 0x00),
 			HID_RI_LOGICAL_MAXIMUM(8, 0x01),
-			HID_RI_REPORT_COUNT(8, 3),
+			HID_RI_REPORT_COUNT(8, 2),
 			HID_RI_REPORT_SIZE(8, 0x01),
 			HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
 			HID_RI_REPORT_COUNT(8, 0x01),
-			HID_RI_REPORT_SIZE(8, 5),
+			HID_RI_REPORT_SIZE(8, 6),
 			HID_RI_INPUT(8, HID_IOF_CONSTANT),
+			HID_RI_USAGE(8, 0x51),
+			HID_RI_LOGICAL_MAXIMUM(8, 0x7F),
+			HID_RI_REPORT_SIZE(8, 8),
+			HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
 			HID_RI_USAGE_PAGE(8, 0x01),
-			HID_RI_USAGE(8, 0x30),
-			HID_RI_USAGE(8, 0x31),
+			HID_RI_UNIT(8, 0x11),
+			HID_RI_UNIT_EXPONENT(8, 0x0E),
 			HID_RI_LOGICAL_MINIMUM(16, 0),
-			HID_RI_LOGICAL_MAXIMUM(16, 1023),
+			HID_RI_LOGICAL_MAXIMUM(16, TOUCH_LOGICAL_MAXIMUM),
 			HID_RI_PHYSICAL_MINIMUM(16, 0),
-			HID_RI_PHYSICAL_MAXIMUM(16, 1),
-			HID_RI_REPORT_COUNT(8, 0x02),
 			HID_RI_REPORT_SIZE(8, 16),
+			HID_RI_USAGE(8, 0x30),
+			HID_RI_PHYSICAL_MAXIMUM(16, TOUCH_PHYSICAL_WIDTH),
+			HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+			HID_RI_USAGE(8, 0x31),
+			HID_RI_PHYSICAL_MAXIMUM(16, TOUCH_PHYSICAL_HEIGHT),
+			HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+			HID_RI_UNIT(8, 0x00),
+			HID_RI_UNIT_EXPONENT(8, 0x00),
+			HID_RI_PHYSICAL_MAXIMUM(8, 0),
+			HID_RI_USAGE_PAGE(8, 0x0D),
+			HID_RI_USAGE(8, 0x30),
+			HID_RI_LOGICAL_MAXIMUM(16, TOUCH_Z_MAXIMUM),
 			HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
 		HID_RI_END_COLLECTION(0),
+		HID_RI_USAGE(8, 0x56),
+		HID_RI_UNIT(16, 0x1001),
+		HID_RI_UNIT_EXPONENT(8, 0x0C),
+		HID_RI_LOGICAL_MAXIMUM(32, 0xFFFF),
+		HID_RI_REPORT_SIZE(8, 16),
+		HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+		HID_RI_UNIT(8, 0x00),
+		HID_RI_UNIT_EXPONENT(8, 0x00),
+		HID_RI_USAGE(8, 0x54),
+		HID_RI_LOGICAL_MAXIMUM(8, 0x01),
+		HID_RI_REPORT_SIZE(8, 8),
+		HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+#if TOUCH_REPORT_BATCH
+		HID_RI_USAGE_PAGE(16, 0xFF00),
+		HID_RI_USAGE(8, 0x01),
+		HID_RI_USAGE(8, 0x02),
+		HID_RI_LOGICAL_MAXIMUM(16, 0xFF),
+		HID_RI_REPORT_COUNT(8, 2),
+		HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+		HID_RI_USAGE(8, 0x03),
+		HID_RI_LOGICAL_MAXIMUM(32, 0xFFFF),
+		HID_RI_REPORT_SIZE(8, 16),
+		HID_RI_REPORT_COUNT(8, 3 * TOUCH_REPORT_BATCH),
+		HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+		HID_RI_USAGE_PAGE(8, 0x0D),
+		HID_RI_LOGICAL_MAXIMUM(8, 0x01),
+		HID_RI_REPORT_SIZE(8, 8),
+		HID_RI_REPORT_COUNT(8, 1),
+#endif
+		HID_RI_USAGE(8, 0x55),
+		HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+	HID_RI_END_COLLECTION(0),
+	HID_RI_USAGE_PAGE(16, 0xFF00),
+	HID_RI_USAGE(8, 0x10),
+	HID_RI_COLLECTION(8, 0x01),
+		HID_RI_REPORT_ID(8, SETTINGS_REPORT_ID),
+		HID_RI_USAGE(8, 0x11),
+		HID_RI_LOGICAL_MAXIMUM(16, 0xFF),
+		HID_RI_REPORT_SIZE(8, 8),
+		HID_RI_REPORT_COUNT(8, sizeof(Settings_t)),
+		HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+		HID_RI_REPORT_ID(8, UPDATE_REPORT_ID),
+		HID_RI_USAGE(8, 0x12),
+		HID_RI_REPORT_COUNT(8, sizeof(USB_UpdateReport_t)),
+		HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
 	HID_RI_END_COLLECTION(0)
 };
 
@@ -100,7 +163,11 @@ const USB_Descriptor_Device_t PROGMEM RelayBoard_DeviceDescriptor =
 
 	.ManufacturerStrIndex   = STRING_ID_Manufacturer,
 	.ProductStrIndex        = STRING_ID_Product,
+#if (USE_INTERNAL_SERIAL != NO_DESCRIPTOR)
+	.SerialNumStrIndex      = USE_INTERNAL_SERIAL,
+#else
 	.SerialNumStrIndex      = STRING_ID_Serial,
+#endif
 
 	.NumberOfConfigurations = FIXED_NUM_CONFIGURATIONS
 };
@@ -117,14 +184,14 @@ const USB_Descriptor_Configuration_t PROGMEM RelayBoard_ConfigurationDescriptor
 			.Header                 = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration},
 
 			.TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t),
-			.TotalInterfaces        = 1,
+			.TotalInterfaces        = ((TOUCH_RAW_STREAM ? 2 : 1) + (TOUCH_PANELS - 1)),
 
 			.ConfigurationNumber    = 1,
 			.ConfigurationStrIndex  = NO_DESCRIPTOR,
 
-			.ConfigAttributes       = USB_CONFIG_ATTR_RESERVED,
+			.ConfigAttributes       = (USB_CONFIG_ATTR_RESERVED | (POWER_REMOTE_WAKEUP ? USB_CONFIG_ATTR_REMOTEWAKEUP : 0)),
 
-			.MaxPowerConsumption    = USB_CONFIG_POWER_MA(500)
+			.MaxPowerConsumption    = USB_CONFIG_POWER_MA(USB_MAX_POWER_MA)
 		},
 
 	.RelayBoardInterface =
@@ -150,7 +217,7 @@ const USB_Descriptor_Configuration_t PROGMEM RelayBoard_ConfigurationDescriptor
 				.CountryCode            = 0x00,
 				.TotalReportDescriptors = 1,
 				.HIDReportType          = HID_DTYPE_Report,
-				.HIDReportLength        = sizeof(MouseReport)
+				.HIDReportLength        = sizeof(TouchscreenReport)
 			},
 
 		.HID_ReportINEndpoint =
@@ -160,8 +227,74 @@ const USB_Descriptor_Configuration_t PROGMEM RelayBoard_ConfigurationDescriptor
 				.EndpointAddress        = MOUSE_EPADDR,
 				.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
 				.EndpointSize           = MOUSE_EPSIZE,
-				.PollingIntervalMS      = 0x05
-			}
+				.PollingIntervalMS      = MOUSE_POLLING_INTERVAL_MS
+			},
+
+#if TOUCH_RAW_STREAM
+	.RawStreamInterface =
+		{
+			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
+
+			.InterfaceNumber        = 1,
+			.AlternateSetting       = 0,
+
+			.TotalEndpoints         = 1,
+
+			.Class                  = USB_CSCP_VendorSpecificClass,
+			.SubClass               = USB_CSCP_VendorSpecificSubclass,
+			.Protocol               = USB_CSCP_VendorSpecificProtocol,
+
+			.InterfaceStrIndex      = NO_DESCRIPTOR
+		},
+
+		.RawStreamINEndpoint =
+			{
+				.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
+
+				.EndpointAddress        = RAW_EPADDR,
+				.Attributes             = (EP_TYPE_BULK | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
+				.EndpointSize           = RAW_EPSIZE,
+				.PollingIntervalMS      = 0x00
+			},
+#endif
+
+#if (TOUCH_PANELS > 1)
+	.Panel1Interface =
+		{
+			.Header                 = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
+
+			.InterfaceNumber        = PANEL1_INTERFACE,
+			.AlternateSetting       = 0,
+
+			.TotalEndpoints         = 1,
+
+			.Class                  = HID_CSCP_HIDClass,
+			.SubClass               = HID_CSCP_NonBootSubclass,
+			.Protocol               = HID_CSCP_NonBootProtocol,
+
+			.InterfaceStrIndex      = NO_DESCRIPTOR
+		},
+		.Panel1_HID =
+			{
+				.Header                 = {.Size = sizeof(USB_HID_Descriptor_HID_t), .Type = HID_DTYPE_HID},
+
+				.HIDSpec                = VERSION_BCD(1,1,1),
+				.CountryCode            = 0x00,
+				.TotalReportDescriptors = 1,
+				.HIDReportType          = HID_DTYPE_Report,
+				.HIDReportLength        = sizeof(TouchscreenReport)
+			},
+
+		.Panel1_ReportINEndpoint =
+			{
+				.Header                 = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
+
+				.EndpointAddress        = PANEL1_EPADDR,
+				.Attributes             = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
+				.EndpointSize           = MOUSE_EPSIZE,
+				.PollingIntervalMS      = MOUSE_POLLING_INTERVAL_MS
+			},
+#endif
 };
 
 /** Language descriptor structure. This descriptor, located in FLASH memory, is returned when the host requests
@@ -198,7 +331,8 @@ const USB_Descriptor_String_t PROGMEM RelayBoard_ProductString =
 };
 
 /** Serial number string. This is a Unicode string containing the device's unique serial number, expressed as a
- *  series of uppercase hexadecimal digits.
+ *  series of uppercase hexadecimal digits. Only used on parts without a unique serial number in their signature
+ *  row, which LUFA reports on its own through \c USE_INTERNAL_SERIAL.
  */
 const USB_Descriptor_String_t PROGMEM RelayBoard_SerialString =
 {
@@ -255,12 +389,21 @@ uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
 			}
 			break;
 		case HID_DTYPE_HID:
+#if (TOUCH_PANELS > 1)
+			if (wIndex == PANEL1_INTERFACE)
+			{
+				Address = &RelayBoard_ConfigurationDescriptor.Panel1_HID;
+				Size    = sizeof(USB_HID_Descriptor_HID_t);
+				break;
+			}
+#endif
 			Address = &RelayBoard_ConfigurationDescriptor.HID_MouseHID;
 			Size    = sizeof(USB_HID_Descriptor_HID_t);
 			break;
 		case HID_DTYPE_Report:
-			Address = &MouseReport;
-			Size    = sizeof(MouseReport);
+			/* Every panel interface shares the touch screen report descriptor */
+			Address = &TouchscreenReport;
+			Size    = sizeof(TouchscreenReport);
 			break;
 	}
 
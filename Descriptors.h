@@ -41,12 +41,34 @@
 		#include <avr/pgmspace.h>
 		#include <LUFA/Drivers/USB/USB.h>
 
+		#include "Config/AppConfig.h"
+		#include "settings.h"
+		#include "enter_bootloader.h"
+
 	/* Macros: */
-		/** Endpoint address of the Mouse HID reporting IN endpoint. */
+		/** HID report ID of the touch input report and its Contact Count Maximum feature. */
+		#define TOUCH_REPORT_ID           1
+
+		/** HID report ID of the runtime settings feature report, see \ref Settings_t. */
+		#define SETTINGS_REPORT_ID        2
+
+		/** HID report ID of the firmware update feature report, see \ref USB_UpdateReport_t. */
+		#define UPDATE_REPORT_ID          3
+
+		/** Endpoint address of the touch screen HID reporting IN endpoint. */
 		#define MOUSE_EPADDR              (ENDPOINT_DIR_IN | 1)
 
-		/** Size in bytes of the Mouse HID reporting IN endpoint. */
-		#define MOUSE_EPSIZE              8
+		/** Endpoint address of the raw sample stream bulk IN endpoint. */
+		#define RAW_EPADDR                (ENDPOINT_DIR_IN | 2)
+
+		/** Size in bytes of the raw sample stream bulk IN endpoint. */
+		#define RAW_EPSIZE                64
+
+		/** Interface number of the second panel's HID interface, after the raw sample stream's. */
+		#define PANEL1_INTERFACE          (TOUCH_RAW_STREAM ? 2 : 1)
+
+		/** Endpoint address of the second panel's HID reporting IN endpoint. */
+		#define PANEL1_EPADDR             (ENDPOINT_DIR_IN | 3)
 
 	/* Type Defines: */
 		/** Type define for the device configuration descriptor structure. This must be defined in the
@@ -61,6 +83,19 @@
 			USB_Descriptor_Interface_t            RelayBoardInterface;
 			USB_HID_Descriptor_HID_t              HID_MouseHID;
 			USB_Descriptor_Endpoint_t             HID_ReportINEndpoint;
+
+#if TOUCH_RAW_STREAM
+			// Raw Sample Stream Interface
+			USB_Descriptor_Interface_t            RawStreamInterface;
+			USB_Descriptor_Endpoint_t             RawStreamINEndpoint;
+#endif
+
+#if (TOUCH_PANELS > 1)
+			// Second Panel Interface
+			USB_Descriptor_Interface_t            Panel1Interface;
+			USB_HID_Descriptor_HID_t              Panel1_HID;
+			USB_Descriptor_Endpoint_t             Panel1_ReportINEndpoint;
+#endif
 		} USB_Descriptor_Configuration_t;
 
 		/** Enum for the device string descriptor IDs within the device. Each string descriptor should
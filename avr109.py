@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+"""Pipelined AVR109 flash writer for the Caterina bootloader, as used by program.py. Instead of
+waiting for the answer to every block command like avrdude, it keeps a window of block writes and
+reads in flight, so the bootloader never idles between pages, and verifies the result against a
+CRC of the image. Run on its own it tests the writer against a mock bootloader."""
+
+import os, random, select, termios, tty
+
+# Block commands kept in flight; the answers of a full window of reads must fit the 4 KiB tty
+# input buffer, or the kernel throttles the bootloader while this side is still sending
+WINDOW = 8
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT as computed by avr-libc's _crc_ccitt_update(), which the firmware reports."""
+    for byte in data:
+        byte ^= crc & 0xFF
+        byte ^= (byte << 4) & 0xFF
+        crc = (((byte << 8) | (crc >> 8)) ^ (byte >> 4) ^ (byte << 3)) & 0xFFFF
+    return crc
+
+def read_hex(text):
+    """Parses Intel HEX text into the flash image it describes, gaps filled with 0xFF."""
+    image = bytearray()
+    base = 0
+    for line in text.splitlines():
+        line = line.strip()
+        if not line:
+            continue
+        if not line.startswith(':'):
+            raise ValueError('not an Intel HEX line: %r' % line)
+        record = bytes.fromhex(line[1:])
+        if sum(record) & 0xFF:
+            raise ValueError('checksum error in %r' % line)
+        length, address, kind, data = record[0], (record[1] << 8) | record[2], record[3], record[4:-1]
+        if len(data) != length:
+            raise ValueError('length error in %r' % line)
+        if kind == 0x00:
+            address += base
+            if len(image) < address + length:
+                image.extend(b'\xff' * (address + length - len(image)))
+            image[address:address + length] = data
+        elif kind == 0x01:
+            break
+        elif kind == 0x02:
+            base = int.from_bytes(data, 'big') << 4
+        elif kind == 0x04:
+            base = int.from_bytes(data, 'big') << 16
+    return bytes(image)
+
+def write_hex(image, width=16):
+    lines = []
+    for address in range(0, len(image), width):
+        data = image[address:address + width]
+        record = bytes([len(data), address >> 8, address & 0xFF, 0x00]) + data
+        lines.append(':%s%02X' % (record.hex().upper(), -sum(record) & 0xFF))
+    lines.append(':00000001FF')
+    return '\n'.join(lines) + '\n'
+
+class VerifyError(Exception):
+    pass
+
+class TtyPort:
+    """Bootloader tty in raw mode, with a timeout on every read."""
+
+    def __init__(self, node, timeout=1.0):
+        self.fd = os.open(node, os.O_RDWR | os.O_NOCTTY)
+        self.timeout = timeout
+        tty.setraw(self.fd)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            view = view[os.write(self.fd, view):]
+
+    def read(self, length):
+        data = bytearray()
+        while len(data) < length:
+            if not select.select([self.fd], [], [], self.timeout)[0]:
+                raise TimeoutError('bootloader did not answer')
+            data += os.read(self.fd, length - len(data))
+        return bytes(data)
+
+    def close(self):
+        os.close(self.fd)
+
+class Bootloader:
+    """AVR109 client for Caterina, which erases and writes a flash page per block command and
+    advances its address after every block."""
+
+    def __init__(self, port):
+        self.port = port
+
+    def command(self, request, length=1):
+        self.port.write(request)
+        return self.port.read(length)
+
+    def expect_cr(self, request):
+        if self.command(request) != b'\r':
+            raise VerifyError('bootloader refused %r' % request[:1])
+
+    def block_size(self):
+        answer = self.command(b'b', 3)
+        if answer[:1] != b'Y':
+            raise VerifyError('bootloader has no block mode')
+        return (answer[1] << 8) | answer[2]
+
+    def pipeline(self, requests, length):
+        """Sends the requests with up to WINDOW of them unanswered, returning their answers of
+        length bytes each in order."""
+        answers = []
+        sent = 0
+        while len(answers) < len(requests):
+            while sent < len(requests) and sent - len(answers) < WINDOW:
+                self.port.write(requests[sent])
+                sent += 1
+            answers.append(self.port.read(length))
+        return answers
+
+    def program(self, image):
+        """Writes the image from address 0, reads it back and checks its CRC."""
+        page = self.block_size()
+        image = bytes(image) + b'\xff' * (-len(image) % page)
+        pages = [image[offset:offset + page] for offset in range(0, len(image), page)]
+        header = bytes([ord('B'), page >> 8, page & 0xFF, ord('F')])
+
+        self.expect_cr(b'P')
+        self.expect_cr(b'A\x00\x00')
+        for answer in self.pipeline([header + data for data in pages], 1):
+            if answer != b'\r':
+                raise VerifyError('bootloader refused a page')
+
+        self.expect_cr(b'A\x00\x00')
+        header = bytes([ord('g'), page >> 8, page & 0xFF, ord('F')])
+        readback = b''.join(self.pipeline([header] * len(pages), page))
+        if crc16(readback) != crc16(image):
+            bad = next(n for n, data in enumerate(pages) if readback[n * page:(n + 1) * page] != data)
+            raise VerifyError('flash differs from the image at 0x%04x' % (bad * page))
+
+        self.expect_cr(b'L')
+
+    def exit(self):
+        """Leaves the bootloader for the new application."""
+        self.expect_cr(b'E')
+
+class MockCaterina:
+    """Caterina's AVR109 command set on a simulated ATmega32U4, for testing the writer without
+    hardware. It answers each command as soon as the command is complete and records how many
+    commands the writer had sent ahead of reading their answers."""
+
+    PAGE = 128
+
+    def __init__(self, flash_size=0x7000, corrupt=None):
+        self.flash = bytearray(random.getrandbits(8) for _ in range(flash_size))
+        self.corrupt = corrupt
+        self.address = 0
+        self.pending = bytearray()
+        self.answers = bytearray()
+        self.unanswered = 0
+        self.max_unanswered = 0
+
+    def write(self, data):
+        self.pending += data
+        while self.pending:
+            size = self.command_size()
+            if size is None or len(self.pending) < size:
+                break
+            request, self.pending = bytes(self.pending[:size]), self.pending[size:]
+            self.answers += self.execute(request)
+            self.unanswered += 1
+            self.max_unanswered = max(self.max_unanswered, self.unanswered)
+
+    def command_size(self):
+        command = self.pending[:1]
+        if command == b'A':
+            return 3
+        if command == b'g':
+            return 4
+        if command == b'B':
+            return 4 + ((self.pending[1] << 8) | self.pending[2]) if len(self.pending) >= 3 else None
+        return 1
+
+    def execute(self, request):
+        command = request[:1]
+        if command == b'b':
+            return bytes([ord('Y'), self.PAGE >> 8, self.PAGE & 0xFF])
+        if command == b'A':
+            self.address = ((request[1] << 8) | request[2]) << 1
+            return b'\r'
+        if command == b'B' and request[3:4] == b'F':
+            data = bytearray(request[4:])
+            if self.corrupt is not None and self.address <= self.corrupt < self.address + len(data):
+                data[self.corrupt - self.address] ^= 0x01
+            start = self.address - self.address % self.PAGE
+            self.flash[start:start + self.PAGE] = b'\xff' * self.PAGE
+            self.flash[self.address:self.address + len(data)] = data
+            self.address += len(data)
+            return b'\r'
+        if command == b'g' and request[3:4] == b'F':
+            size = (request[1] << 8) | request[2]
+            data = bytes(self.flash[self.address:self.address + size])
+            self.address += size
+            return data
+        if command in (b'P', b'L', b'E'):
+            return b'\r'
+        return b'?'
+
+    def read(self, length):
+        if len(self.answers) < length:
+            raise TimeoutError('bootloader did not answer')
+        data, self.answers = bytes(self.answers[:length]), self.answers[length:]
+        self.unanswered -= 1
+        return data
+
+def self_test():
+    random.seed(1)
+    image = bytes(random.getrandbits(8) for _ in range(20000))
+    assert read_hex(write_hex(image)) == image
+
+    mock = MockCaterina()
+    loader = Bootloader(mock)
+    loader.program(image)
+    loader.exit()
+    assert mock.flash[:len(image)] == image
+    assert crc16(mock.flash[:len(image)]) == crc16(image)
+    assert mock.max_unanswered == WINDOW, 'block commands were not pipelined'
+
+    try:
+        Bootloader(MockCaterina(corrupt=12345)).program(image)
+    except VerifyError as error:
+        assert '0x3000' in str(error), error
+    else:
+        raise AssertionError('a corrupted page was not detected')
+
+    print('pipelined writer flashes the mock bootloader')
+
+if __name__ == '__main__':
+    self_test()
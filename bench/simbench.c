@@ -0,0 +1,469 @@
+/** \file
+ *
+ *  Cycle benchmark of the real firmware image under simavr. The ATmega32U4 model has no USB host,
+ *  so the USB side is emulated by injecting calls: every millisecond the bench waits for the main
+ *  loop to reach HID_Device_USBTask() and calls EVENT_USB_Device_StartOfFrame() and
+ *  CALLBACK_HID_Device_CreateHIDReport() from there, saving and restoring the CPU state around
+ *  each injected call. The ADC is fed from a simple resistive panel model driven by the port state
+ *  latched at every conversion start, matched against the scan phases panel.h derives from the
+ *  panel profile the firmware was built with. The report callback is injected for the first panel.
+ *
+ *  Cycles are counted from function entry until the stack pointer rises above its entry value,
+ *  so interrupts nested into a handler count towards it, as they do on hardware. The worst case of
+ *  every handler is compared against the budgets file and the bench exits non-zero on a regression,
+ *  or on a handler without a budget. With -r the worst cases plus \ref BUDGET_HEADROOM_PERCENT are
+ *  written to the budgets file instead, stamped with the toolchain given on the command line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stddef.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_adc.h>
+
+/* Built against the mocked registers of the host harness, for the report layout and the panel
+ * profile of the firmware under test */
+#include "touch.h"
+
+#define FRAME_CYCLES   (F_CPU / 1000)
+#define RUN_MS         400
+#define TOUCH_MS       100
+
+/** Margin a recorded budget leaves above the worst case measured on the reference build. */
+#define BUDGET_HEADROOM_PERCENT 25
+
+/* Data space addresses of the panel ports */
+#define IO_DDRB        0x24
+#define IO_PORTB       0x25
+#define IO_DDRF        0x30
+#define IO_PORTF       0x31
+
+/** Output parameters of the injected report callback, laid out in scratch space below the stack. */
+typedef struct
+{
+	uint8_t                ReportID;
+	uint8_t                Reserved;
+	uint16_t               ReportSize;
+	USB_TouchReport_Data_t ReportData;
+} __attribute__((packed)) report_args_t;
+
+/** Stack space below the main loop's frame the bench may borrow for \ref report_args_t. */
+#define REPORT_SCRATCH_MAX 96
+
+_Static_assert(sizeof(report_args_t) <= REPORT_SCRATCH_MAX, "report arguments do not fit the scratch space");
+
+/* Registers panel.h reads through PANELn_PORT and PANELn_DDR, latched from the simulated ports */
+unsigned long mock_io_accesses;
+uint8_t       mock_PORTF;
+uint8_t       mock_DDRF;
+uint8_t       mock_PORTB;
+uint8_t       mock_DDRB;
+
+enum Handler
+{
+	HANDLER_SOF,
+	HANDLER_REPORT,
+	HANDLER_ADC_ISR,
+	HANDLER_MAIN_LOOP,
+	HANDLER_COUNT,
+};
+
+static const char* const handler_names[HANDLER_COUNT] =
+	{
+		[HANDLER_SOF]       = "EVENT_USB_Device_StartOfFrame",
+		[HANDLER_REPORT]    = "CALLBACK_HID_Device_CreateHIDReport",
+		[HANDLER_ADC_ISR]   = "__vector_29",
+		[HANDLER_MAIN_LOOP] = "main_loop",
+	};
+
+typedef struct
+{
+	uint32_t      Address;
+	uint64_t      Calls;
+	avr_cycle_count_t Total;
+	avr_cycle_count_t Max;
+	avr_cycle_count_t Entry;
+	uint16_t      EntrySP;
+	int           Active;
+} handler_stats_t;
+
+static handler_stats_t handlers[HANDLER_COUNT];
+
+typedef struct
+{
+	int      Active;
+	uint16_t SP;
+	uint32_t PC;
+	uint8_t  Registers[32];
+	uint8_t  SREG[8];
+} injection_t;
+
+static injection_t injection;
+
+static avr_t*   avr;
+static uint32_t hid_task_address;
+static uint32_t hid_interface_address;
+
+static uint16_t GetSP(void)
+{
+	return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+static void SetSP(const uint16_t sp)
+{
+	avr->data[R_SPL] = sp & 0xFF;
+	avr->data[R_SPH] = sp >> 8;
+}
+
+static uint32_t Symbol(const elf_firmware_t* const fw, const char* const name)
+{
+	for (uint32_t i = 0; i < fw->symbolcount; i++)
+	{
+		if (!strcmp(fw->symbol[i]->symbol, name))
+		  return fw->symbol[i]->addr;
+	}
+
+	fprintf(stderr, "symbol %s not found in firmware\n", name);
+	exit(2);
+}
+
+/** Returns the reading of panel \p n touched at a fixed spot, if \p channel is one of its
+ *  electrodes driven in one of its scan phases. Untouched, only the standby YD readout rises.
+ */
+#define PANEL_SAMPLE(n, channel, touched) \
+	do \
+	{ \
+		uint8_t port = (PANEL##n##_PORT & PANEL_MASK(n)); \
+		uint8_t ddr  = (PANEL##n##_DDR & PANEL_MASK(n)); \
+		if ((port == PANEL_STBY_PORT(n)) && (ddr == PANEL_STBY_DDR(n)) && ((channel) == PANEL##n##_ADC_YD)) \
+		  return (touched) ? 400 : 1023; \
+		if (!(touched)) \
+		  break; \
+		if ((port == PANEL_Y_PORT(n)) && (ddr == PANEL_Y_DDR(n)) && ((channel) == PANEL_Y_ADC(n))) \
+		  return 300; \
+		if ((port == PANEL_X_PORT(n)) && (ddr == PANEL_X_DDR(n)) && ((channel) == PANEL_X_ADC(n))) \
+		  return 512; \
+		if ((port == PANEL_STBY_PORT(n)) && (ddr == PANEL_STBY_DDR(n)) && ((channel) == PANEL##n##_ADC_XR)) \
+		  return 300; \
+	} while (0)
+
+/** Returns the 10-bit reading of ADC \p channel, with every panel touched from TOUCH_MS on. */
+static uint16_t PanelSample(const uint8_t channel, const int touched)
+{
+	mock_PORTF = avr->data[IO_PORTF];
+	mock_DDRF  = avr->data[IO_DDRF];
+	mock_PORTB = avr->data[IO_PORTB];
+	mock_DDRB  = avr->data[IO_DDRB];
+
+	PANEL_SAMPLE(0, channel, touched);
+#if (TOUCH_PANELS > 1)
+	PANEL_SAMPLE(1, channel, touched);
+#endif
+
+	return 0;
+}
+
+static void ADCTrigger(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+	union { avr_adc_mux_t mux; uint32_t v; } e = { .v = value };
+
+	if (e.mux.kind != ADC_MUX_SINGLE)
+	  return;
+
+	int      touched = (avr->cycle >= (TOUCH_MS * FRAME_CYCLES));
+	uint16_t reading = PanelSample(e.mux.src, touched);
+
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + e.mux.src),
+	              (reading * 5000UL + 1022) / 1023);
+}
+
+/** Calls a firmware function from the current instruction, as if it had been called from here. */
+static void Inject(const uint32_t address)
+{
+	injection.Active = 1;
+	injection.SP     = GetSP();
+	injection.PC     = avr->pc;
+	memcpy(injection.Registers, avr->data, sizeof(injection.Registers));
+	memcpy(injection.SREG, avr->sreg, sizeof(injection.SREG));
+
+	uint16_t sp  = injection.SP;
+	uint16_t ret = avr->pc >> 1;
+
+	/* Scratch space below the stack for the report callback's output parameters */
+	sp -= sizeof(report_args_t);
+	uint16_t scratch = sp + 1;
+	uint16_t id      = scratch + offsetof(report_args_t, ReportID);
+	uint16_t data    = scratch + offsetof(report_args_t, ReportData);
+	uint16_t size    = scratch + offsetof(report_args_t, ReportSize);
+
+	if (address == handlers[HANDLER_REPORT].Address)
+	{
+		avr->data[24] = hid_interface_address & 0xFF;
+		avr->data[25] = hid_interface_address >> 8;
+		avr->data[22] = id & 0xFF;
+		avr->data[23] = id >> 8;
+		avr->data[20] = 0; /* HID_REPORT_ITEM_In */
+		avr->data[18] = data & 0xFF;
+		avr->data[19] = data >> 8;
+		avr->data[16] = size & 0xFF;
+		avr->data[17] = size >> 8;
+		avr->data[id] = 0;
+	}
+
+	avr->data[sp--] = ret & 0xFF;
+	avr->data[sp--] = ret >> 8;
+	SetSP(sp);
+
+	avr->pc = address;
+}
+
+static void Restore(void)
+{
+	memcpy(avr->data, injection.Registers, sizeof(injection.Registers));
+	memcpy(avr->sreg, injection.SREG, sizeof(injection.SREG));
+	SetSP(injection.SP);
+	avr->pc = injection.PC;
+	injection.Active = 0;
+}
+
+static void Account(void)
+{
+	uint16_t sp = GetSP();
+
+	for (int h = 0; h < HANDLER_MAIN_LOOP; h++)
+	{
+		handler_stats_t* s = &handlers[h];
+
+		if (!s->Active && (avr->pc == s->Address))
+		{
+			s->Active  = 1;
+			s->Entry   = avr->cycle;
+			s->EntrySP = sp;
+		}
+		else if (s->Active && (sp > s->EntrySP))
+		{
+			avr_cycle_count_t spent = avr->cycle - s->Entry;
+
+			s->Active = 0;
+			s->Calls++;
+			s->Total += spent;
+			if (spent > s->Max)
+			  s->Max = spent;
+		}
+	}
+}
+
+static int CheckBudgets(const char* const path)
+{
+	FILE* f = fopen(path, "r");
+	if (!f)
+	{
+		perror(path);
+		return 2;
+	}
+
+	int  failed = 0;
+	int  budgeted[HANDLER_COUNT] = {0};
+	char line[128];
+
+	printf("%-36s %8s %10s %10s %10s\n", "handler", "calls", "avg", "max", "budget");
+
+	while (fgets(line, sizeof(line), f))
+	{
+		char          name[64];
+		unsigned long budget;
+
+		if ((line[0] == '#') || (sscanf(line, "%63s %lu", name, &budget) != 2))
+		  continue;
+
+		for (int h = 0; h < HANDLER_COUNT; h++)
+		{
+			if (strcmp(name, handler_names[h]))
+			  continue;
+
+			handler_stats_t* s   = &handlers[h];
+			unsigned long    avg = s->Calls ? (unsigned long)(s->Total / s->Calls) : 0;
+			int              bad = !s->Calls || (s->Max > budget);
+
+			printf("%-36s %8llu %10lu %10llu %10lu%s\n", name, (unsigned long long)s->Calls, avg,
+			       (unsigned long long)s->Max, budget, bad ? "  FAIL" : "");
+			failed |= bad;
+			budgeted[h] = 1;
+		}
+	}
+
+	fclose(f);
+
+	/* A budgets file that was never recorded must not pass */
+	for (int h = 0; h < HANDLER_COUNT; h++)
+	{
+		if (budgeted[h])
+		  continue;
+
+		printf("%-36s %8llu %10s %10llu %10s  FAIL\n", handler_names[h], (unsigned long long)handlers[h].Calls,
+		       "", (unsigned long long)handlers[h].Max, "none");
+		failed = 1;
+	}
+
+	printf("frame budget: %lu cycles\n", FRAME_CYCLES);
+	return failed;
+}
+
+/** Writes the worst case of every handler plus \ref BUDGET_HEADROOM_PERCENT as the new budgets.
+ *
+ *  \param[in] path       Budgets file to write
+ *  \param[in] toolchain  Compiler and simavr versions the worst cases were measured with
+ *
+ *  \return Zero once written, non-zero if a handler never ran or the file could not be written.
+ */
+static int RecordBudgets(const char* const path, const char* const toolchain)
+{
+	for (int h = 0; h < HANDLER_COUNT; h++)
+	{
+		if (handlers[h].Calls)
+		  continue;
+
+		fprintf(stderr, "%s never ran, nothing to record\n", handler_names[h]);
+		return 1;
+	}
+
+	FILE* f = fopen(path, "w");
+	if (!f)
+	{
+		perror(path);
+		return 2;
+	}
+
+	fprintf(f, "# Worst case cycle budgets per handler at 8 MHz, checked by \"make bench\".\n"
+	           "# One 1 ms USB frame is 8000 cycles; the ADC ISR runs once per conversion.\n"
+	           "#\n"
+	           "# Recorded by \"make bench-record\" on the reference build, worst case plus %d%% headroom,\n"
+	           "# with %s.\n"
+	           "#\n"
+	           "# handler                              max cycles\n", BUDGET_HEADROOM_PERCENT, toolchain);
+
+	for (int h = 0; h < HANDLER_COUNT; h++)
+	{
+		unsigned long long budget = (handlers[h].Max * (100 + BUDGET_HEADROOM_PERCENT) + 99) / 100;
+
+		fprintf(f, "%-38s %llu\n", handler_names[h], budget);
+		printf("%-36s worst %llu, budget %llu\n", handler_names[h], (unsigned long long)handlers[h].Max, budget);
+	}
+
+	return fclose(f) ? 2 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* toolchain = NULL;
+
+	if ((argc == 5) && !strcmp(argv[1], "-r"))
+	{
+		toolchain = argv[2];
+		argv += 2;
+		argc -= 2;
+	}
+
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: %s [-r TOOLCHAIN] FIRMWARE.elf BUDGETS\n", argv[0]);
+		return 2;
+	}
+
+	elf_firmware_t fw;
+	memset(&fw, 0, sizeof(fw));
+	if (elf_read_firmware(argv[1], &fw))
+	{
+		fprintf(stderr, "unable to load %s\n", argv[1]);
+		return 2;
+	}
+
+	avr = avr_make_mcu_by_name("atmega32u4");
+	if (!avr)
+	{
+		fprintf(stderr, "simavr has no atmega32u4 core\n");
+		return 2;
+	}
+
+	avr_init(avr);
+	avr_load_firmware(avr, &fw);
+	avr->frequency = F_CPU;
+	avr->avcc      = 5000;
+	avr->aref      = 5000;
+	avr->log       = LOG_ERROR;
+
+	handlers[HANDLER_SOF].Address     = Symbol(&fw, handler_names[HANDLER_SOF]);
+	handlers[HANDLER_REPORT].Address  = Symbol(&fw, handler_names[HANDLER_REPORT]);
+	handlers[HANDLER_ADC_ISR].Address = Symbol(&fw, handler_names[HANDLER_ADC_ISR]);
+	hid_task_address                  = Symbol(&fw, "HID_Device_USBTask");
+	hid_interface_address             = Symbol(&fw, "Mouse_HID_Interface") & 0xFFFF;
+
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_OUT_TRIGGER), ADCTrigger, NULL);
+
+	avr_cycle_count_t next_frame = FRAME_CYCLES;
+	avr_cycle_count_t loop_entry = 0;
+	int               pending    = 0;
+
+	while (avr->cycle < (RUN_MS * FRAME_CYCLES))
+	{
+		int state = avr_run(avr);
+		if ((state == cpu_Done) || (state == cpu_Crashed))
+		{
+			fprintf(stderr, "firmware stopped at pc 0x%04x\n", avr->pc);
+			return 2;
+		}
+
+		Account();
+
+		if (injection.Active)
+		{
+			if (GetSP() >= (uint16_t)(injection.SP - sizeof(report_args_t)))
+			{
+				Restore();
+				loop_entry = avr->cycle;
+			}
+			continue;
+		}
+
+		if (avr->cycle >= next_frame)
+		{
+			next_frame += FRAME_CYCLES;
+			pending = 2;
+		}
+
+		if (avr->pc != hid_task_address)
+		  continue;
+
+		/* One main loop iteration runs between consecutive HID_Device_USBTask() calls */
+		handler_stats_t* loop = &handlers[HANDLER_MAIN_LOOP];
+		if (loop_entry)
+		{
+			avr_cycle_count_t spent = avr->cycle - loop_entry;
+
+			loop->Calls++;
+			loop->Total += spent;
+			if (spent > loop->Max)
+			  loop->Max = spent;
+		}
+		loop_entry = avr->cycle;
+
+		if (pending == 2)
+		{
+			pending = 1;
+			Inject(handlers[HANDLER_SOF].Address);
+			Account();
+		}
+		else if (pending == 1)
+		{
+			pending = 0;
+			Inject(handlers[HANDLER_REPORT].Address);
+			Account();
+		}
+	}
+
+	return toolchain ? RecordBudgets(argv[2], toolchain) : CheckBudgets(argv[2]);
+}
@@ -0,0 +1,318 @@
+/** \file
+ *
+ *  Persistent affine touch calibration. The transform maps uncalibrated panel coordinates onto the
+ *  full reported range, correcting offset, scale, rotation and swapped axes in one step. It is
+ *  computed once from three reference points, or written by the host, and stored in EEPROM with a
+ *  CRC; per sample it costs four multiplies and no divisions. Every panel has its own transform and
+ *  record.
+ *
+ *  A new transform is used right away and saved in the background, a byte per EEPROM write, like
+ *  the settings; a save torn by a reset fails its CRC and leaves the panel uncalibrated.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include "calibration.h"
+
+#if TOUCH_CALIBRATION
+
+/** Layout version of the stored calibration, bumped on incompatible changes. */
+#define CALIBRATION_VERSION    1
+
+/** Largest magnitude of the scale and rotation coefficients, a factor of 32. Together with
+ *  \ref CALIBRATION_OFFSET_MAX it keeps every term of \ref Transform() within an \c int32_t.
+ */
+#define CALIBRATION_COEFF_MAX  (1L << (CALIBRATION_FRAC_BITS + 5))
+
+/** Largest magnitude of the translation coefficients, 32 times the reported range. */
+#define CALIBRATION_OFFSET_MAX (CALIBRATION_COEFF_MAX << TOUCH_RESOLUTION_BITS)
+
+/** Smallest magnitude of the determinant of the scale and rotation coefficients, with twice
+ *  \ref CALIBRATION_FRAC_BITS fractional bits: transforms shrinking the panel's area by more than
+ *  256 times are degenerate.
+ */
+#define CALIBRATION_DET_MIN    (1LL << (2 * CALIBRATION_FRAC_BITS - 8))
+
+/** EEPROM calibration record. */
+typedef struct
+{
+	uint8_t              Version;
+	Calibration_Matrix_t Calibration;
+	uint8_t              CRC; /**< CRC-8 of the preceding bytes. */
+} __attribute__((packed)) CalibrationRecord_t;
+
+static CalibrationRecord_t EEMEM calibration_record[TOUCH_PANELS];
+
+/** Transforms in use. */
+static Calibration_Matrix_t calibration[TOUCH_PANELS];
+
+/** Translation terms of \ref calibration with the rounding of the final shift folded in. */
+static int32_t offset[TOUCH_PANELS][2];
+
+/** Uncalibrated coordinates captured for a reference point. */
+typedef struct
+{
+	int32_t X;
+	int32_t Y;
+	int32_t TargetX;
+	int32_t TargetY;
+} CalibrationCapture_t;
+
+/** Reference points captured for every panel. */
+static CalibrationCapture_t captured[TOUCH_PANELS][CALIBRATION_POINTS];
+
+/** Records being saved, or last saved, for every panel. */
+static CalibrationRecord_t save_record[TOUCH_PANELS];
+
+/** Bytes of \ref save_record written so far for every panel, and the number to write. */
+static uint8_t save_offset[TOUCH_PANELS];
+static uint8_t save_end[TOUCH_PANELS];
+
+/** Computes the CRC of a calibration record, excluding its CRC field. */
+static uint8_t RecordCRC(const CalibrationRecord_t* const record)
+{
+	const uint8_t* data = (const uint8_t*)record;
+	uint8_t crc = 0;
+
+	for (uint8_t i = 0; i < offsetof(CalibrationRecord_t, CRC); i++)
+	  crc = _crc8_ccitt_update(crc, data[i]);
+
+	return crc;
+}
+
+/** Switches a panel to a transform, without touching the stored calibration. */
+static void Use(const uint8_t Panel, const Calibration_Matrix_t* const Calibration)
+{
+	calibration[Panel] = *Calibration;
+
+	for (uint8_t i = 0; i < 2; i++)
+	  offset[Panel][i] = Calibration->Matrix[i][2] + (1L << (CALIBRATION_FRAC_BITS - 1));
+}
+
+/** Switches a panel to the identity transform, without touching the stored calibration. */
+static void UseIdentity(const uint8_t Panel)
+{
+	const Calibration_Matrix_t identity =
+		{
+			.Matrix = {{1L << CALIBRATION_FRAC_BITS, 0, 0}, {0, 1L << CALIBRATION_FRAC_BITS, 0}},
+		};
+
+	Use(Panel, &identity);
+}
+
+/** Loads the stored calibration of every panel, falling back to the identity transform for a panel
+ *  with none or one failing its CRC.
+ */
+void Calibration_Load(void)
+{
+	for (uint8_t panel = 0; panel < TOUCH_PANELS; panel++)
+	{
+		CalibrationRecord_t record;
+
+		eeprom_read_block(&record, &calibration_record[panel], sizeof(record));
+
+		if ((record.Version == CALIBRATION_VERSION) && (record.CRC == RecordCRC(&record)))
+		  Use(panel, &record.Calibration);
+		else
+		  UseIdentity(panel);
+	}
+}
+
+/** Checks a transform against the coefficient ranges \ref Transform() copes with, and rejects
+ *  degenerate ones collapsing the panel onto a line or nearly so.
+ */
+static bool Acceptable(const Calibration_Matrix_t* const Calibration)
+{
+	for (uint8_t row = 0; row < 2; row++)
+	{
+		for (uint8_t col = 0; col < 2; col++)
+		{
+			if (labs(Calibration->Matrix[row][col]) > CALIBRATION_COEFF_MAX)
+			  return false;
+		}
+
+		if (labs(Calibration->Matrix[row][2]) > CALIBRATION_OFFSET_MAX)
+		  return false;
+	}
+
+	int64_t det = ((int64_t)Calibration->Matrix[0][0] * Calibration->Matrix[1][1]) -
+	              ((int64_t)Calibration->Matrix[0][1] * Calibration->Matrix[1][0]);
+
+	return (det >= CALIBRATION_DET_MIN) || (det <= -CALIBRATION_DET_MIN);
+}
+
+/** Uses a new calibration transform, and saves it in the background.
+ *
+ *  \param[in] Panel        Panel to calibrate, below \ref TOUCH_PANELS
+ *  \param[in] Calibration  New transform
+ *
+ *  \return Boolean \c false if the transform has a coefficient out of range or is degenerate.
+ */
+bool Calibration_Set(const uint8_t Panel, const Calibration_Matrix_t* const Calibration)
+{
+	if (!(Acceptable(Calibration)))
+	  return false;
+
+	save_record[Panel].Version     = CALIBRATION_VERSION;
+	save_record[Panel].Calibration = *Calibration;
+	save_record[Panel].CRC         = RecordCRC(&save_record[Panel]);
+	save_offset[Panel] = 0;
+	save_end[Panel]    = sizeof(CalibrationRecord_t);
+
+	Use(Panel, Calibration);
+	return true;
+}
+
+/** Returns a panel to the identity transform, and invalidates its stored calibration in the
+ *  background.
+ */
+void Calibration_Reset(const uint8_t Panel)
+{
+	save_record[Panel].Version = 0xFF;
+	save_offset[Panel] = 0;
+	save_end[Panel]    = 1;
+
+	UseIdentity(Panel);
+}
+
+/** Saves the next byte of a pending calibration record once the EEPROM is ready, so a save never
+ *  blocks a control request or the main loop for the several milliseconds every EEPROM byte write
+ *  takes.
+ */
+void Calibration_Task(void)
+{
+	if (!(eeprom_is_ready()))
+	  return;
+
+	for (uint8_t panel = 0; panel < TOUCH_PANELS; panel++)
+	{
+		if (save_offset[panel] == save_end[panel])
+		  continue;
+
+		eeprom_update_byte((uint8_t*)&calibration_record[panel] + save_offset[panel],
+		                   ((const uint8_t*)&save_record[panel])[save_offset[panel]]);
+		save_offset[panel]++;
+		return;
+	}
+}
+
+/** Returns the transform a panel is using. */
+const Calibration_Matrix_t* Calibration_Get(const uint8_t Panel)
+{
+	return &calibration[Panel];
+}
+
+/** Solves one output row of the transform from a panel's reference points, by Cramer's rule
+ *  relative to the last point.
+ *
+ *  \return Boolean \c false if a coefficient is out of range, which nearly collinear points give.
+ */
+static bool SolveRow(Calibration_Matrix_t* const solved, const CalibrationCapture_t* const points,
+                     const float det, const bool y)
+{
+	float t0 = (y ? points[0].TargetY : points[0].TargetX) - (y ? points[2].TargetY : points[2].TargetX);
+	float t1 = (y ? points[1].TargetY : points[1].TargetX) - (y ? points[2].TargetY : points[2].TargetX);
+	float x0 = points[0].X - points[2].X;
+	float x1 = points[1].X - points[2].X;
+	float y0 = points[0].Y - points[2].Y;
+	float y1 = points[1].Y - points[2].Y;
+
+	float a = ((t0 * y1) - (t1 * y0)) / det;
+	float b = ((x0 * t1) - (x1 * t0)) / det;
+	float c = (y ? points[2].TargetY : points[2].TargetX) - (a * points[2].X) - (b * points[2].Y);
+
+	a *= (1L << CALIBRATION_FRAC_BITS);
+	b *= (1L << CALIBRATION_FRAC_BITS);
+	c *= (1L << CALIBRATION_FRAC_BITS);
+
+	// Checked before converting, as an out of range float to integer conversion is undefined
+	if ((fabsf(a) > CALIBRATION_COEFF_MAX) || (fabsf(b) > CALIBRATION_COEFF_MAX) ||
+	    (fabsf(c) > CALIBRATION_OFFSET_MAX))
+	{
+		return false;
+	}
+
+	solved->Matrix[y][0] = a + ((a < 0) ? -0.5f : 0.5f);
+	solved->Matrix[y][1] = b + ((b < 0) ? -0.5f : 0.5f);
+	solved->Matrix[y][2] = c + ((c < 0) ? -0.5f : 0.5f);
+	return true;
+}
+
+/** Records a calibration reference point. Once the last point is recorded the transform mapping
+ *  the three points onto their targets is computed, used and stored; this is the only place
+ *  dividing, once per calibration.
+ *
+ *  \param[in] Panel   Panel to calibrate, below \ref TOUCH_PANELS
+ *  \param[in] Index   Reference point, 0 to \ref CALIBRATION_POINTS - 1, recorded in order
+ *  \param[in] X       Uncalibrated X coordinate touched for the point
+ *  \param[in] Y       Uncalibrated Y coordinate touched for the point
+ *  \param[in] Target  Reported position the point should map to
+ *
+ *  \return Boolean \c false if the index is out of range, or after the last one if the points are
+ *          collinear or give a transform \ref Calibration_Set() rejects.
+ */
+bool Calibration_SetPoint(const uint8_t Panel, const uint8_t Index, const uint16_t X, const uint16_t Y,
+                          const Calibration_Point_t* const Target)
+{
+	if (Index >= CALIBRATION_POINTS)
+	  return false;
+
+	CalibrationCapture_t* const points = captured[Panel];
+
+	points[Index].X       = X;
+	points[Index].Y       = Y;
+	points[Index].TargetX = Target->X;
+	points[Index].TargetY = Target->Y;
+
+	if (Index != (CALIBRATION_POINTS - 1))
+	  return true;
+
+	float det = ((float)(points[0].X - points[2].X) * (points[1].Y - points[2].Y)) -
+	            ((float)(points[1].X - points[2].X) * (points[0].Y - points[2].Y));
+
+	if (det == 0)
+	  return false;
+
+	Calibration_Matrix_t solved;
+
+	if (!(SolveRow(&solved, points, det, false)) || !(SolveRow(&solved, points, det, true)))
+	  return false;
+
+	return Calibration_Set(Panel, &solved);
+}
+
+/** Transforms one coordinate with a row of a panel's calibration, clamped to the reported range. */
+static uint16_t Transform(const uint8_t panel, const uint8_t row, const uint16_t x, const uint16_t y)
+{
+	int32_t v = ((calibration[panel].Matrix[row][0] * x) + (calibration[panel].Matrix[row][1] * y) +
+	             offset[panel][row]);
+
+	v >>= CALIBRATION_FRAC_BITS;
+	if (v < 0)
+	  return 0;
+	if (v > TOUCH_LOGICAL_MAXIMUM)
+	  return TOUCH_LOGICAL_MAXIMUM;
+
+	return v;
+}
+
+/** Transforms a coordinate pair with a panel's calibration, clamped to the reported range.
+ *
+ *  \param[in]     Panel  Panel the coordinates were scanned on
+ *  \param[in,out] X  X coordinate
+ *  \param[in,out] Y  Y coordinate
+ */
+void Calibration_Apply(const uint8_t Panel, uint16_t* const X, uint16_t* const Y)
+{
+	uint16_t x = *X;
+	uint16_t y = *Y;
+
+	*X = Transform(Panel, 0, x, y);
+	*Y = Transform(Panel, 1, x, y);
+}
+
+#endif
@@ -0,0 +1,54 @@
+/** \file
+ *
+ *  Header file for calibration.c.
+ */
+
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+	/* Includes: */
+		#include <stdbool.h>
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+
+	/* Macros: */
+		/** Fractional bits of the calibration matrix coefficients. */
+		#define CALIBRATION_FRAC_BITS    12
+
+		/** Number of reference points of a calibration. */
+		#define CALIBRATION_POINTS       3
+
+	/* Type Defines: */
+		/** Affine calibration transform from uncalibrated to reported coordinates, little endian:
+		 *  X' = Matrix[0][0] * X + Matrix[0][1] * Y + Matrix[0][2], and Y' likewise from Matrix[1],
+		 *  every coefficient with \ref CALIBRATION_FRAC_BITS fractional bits.
+		 */
+		typedef struct
+		{
+			int32_t Matrix[2][3];
+		} __attribute__((packed)) Calibration_Matrix_t;
+
+		/** Target position of a calibration reference point, in reported coordinates. */
+		typedef struct
+		{
+			uint16_t X;
+			uint16_t Y;
+		} __attribute__((packed)) Calibration_Point_t;
+
+	/* Function Prototypes: */
+		#if TOUCH_CALIBRATION
+		void Calibration_Load(void);
+		bool Calibration_Set(const uint8_t Panel, const Calibration_Matrix_t* const Calibration);
+		void Calibration_Reset(const uint8_t Panel);
+		void Calibration_Task(void);
+		const Calibration_Matrix_t* Calibration_Get(const uint8_t Panel);
+		bool Calibration_SetPoint(const uint8_t Panel, const uint8_t Index, const uint16_t X, const uint16_t Y,
+		                          const Calibration_Point_t* const Target);
+		void Calibration_Apply(const uint8_t Panel, uint16_t* const X, uint16_t* const Y);
+		#else
+		static inline void Calibration_Load(void) {}
+		static inline void Calibration_Task(void) {}
+		#endif
+
+#endif
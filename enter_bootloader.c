@@ -1,3 +1,11 @@
+/** \file
+ *
+ *  Firmware update entry. The update feature report on the touch interface only reports the running
+ *  image and resets into the resident Caterina bootloader; no image data goes over HID. The new image
+ *  is written by program.py over the bootloader's CDC tty, with the pipelined AVR109 writer in
+ *  avr109.py. Only code in the boot section may write flash, and this firmware does not replace it.
+ */
+
 #include "enter_bootloader.h"
 
 
@@ -10,23 +18,88 @@ static volatile uint16_t *const bootKeyPtr = (volatile uint16_t *)0x0800;
 #endif
 
 
+/** End of the application image in flash, the initial values of \c .data following the code. */
+extern const uint8_t __data_load_end[];
+
+/** Set once the host asked for the bootloader, which is entered from the main loop. */
+static bool update_pending;
+
+/** CRC of the running image, computed a chunk at a time from the main loop after reset. */
+static uint16_t image_crc = 0xFFFF;
+static uint16_t image_crc_address;
+static bool     image_crc_valid;
+
+/** Detaches from the bus and resets into the bootloader. Callers complete the control request
+ *  asking for it first, see \ref Update_Task().
+ */
 void enter_bootloader(void)
 {
-	Endpoint_ClearSETUP();
-	Endpoint_ClearStatusStage();
-	USB_USBTask();
-
 	// If USB is used, detach from the bus and reset it
 	USB_Disable();
 
 	// Disable all interrupts
 	cli();
 
-	// Wait two seconds for the USB detachment to register on the host
-	Delay_MS(2000);
+	// Stay detached long enough for every hub between us and the host to report the disconnect
+	Delay_MS(UPDATE_DETACH_MS);
 
 	// Set the bootloader key to the magic value and force a reset
 	*bootKeyPtr = bootKey; 
-	wdt_enable(WDTO_250MS);
+	wdt_enable(WDTO_15MS);
 	for (;;);
 }
+
+/** Enters the bootloader from the main loop, once the current control request has completed. */
+void Update_RequestBootloader(void)
+{
+	update_pending = true;
+}
+
+/** Processes a write of the update feature report, entering the bootloader if it carries the key.
+ *
+ *  \param[in] Report  Update feature report received from the host
+ */
+void Update_ProcessReport(const USB_UpdateReport_t* const Report)
+{
+	if (Report->Key == MAGIC_BOOT_KEY)
+	  Update_RequestBootloader();
+}
+
+/** Fills in the update feature report with the size and CRC of the running image. Until
+ *  \ref Update_Task() has finished the CRC both read as zero, and the host reads again.
+ *
+ *  \param[out] Report  Update feature report to send to the host
+ */
+void Update_CreateReport(USB_UpdateReport_t* const Report)
+{
+	Report->Key       = 0;
+	Report->ImageSize = image_crc_valid ? (uint16_t)__data_load_end : 0;
+	Report->ImageCRC  = image_crc_valid ? image_crc : 0;
+}
+
+/** Advances the CRC of the running image by \ref UPDATE_CRC_CHUNK bytes, and enters the bootloader
+ *  if the host asked for it. The short delay lets the host collect the status stage of its request,
+ *  which the control endpoint has only queued so far.
+ */
+void Update_Task(void)
+{
+	if (!image_crc_valid)
+	{
+		uint16_t Size = (uint16_t)__data_load_end;
+		uint16_t End  = Size;
+
+		if ((Size - image_crc_address) > UPDATE_CRC_CHUNK)
+		  End = image_crc_address + UPDATE_CRC_CHUNK;
+
+		for (; image_crc_address < End; image_crc_address++)
+		  image_crc = _crc_ccitt_update(image_crc, pgm_read_byte(image_crc_address));
+
+		image_crc_valid = (image_crc_address == Size);
+	}
+
+	if (!update_pending)
+	  return;
+
+	Delay_MS(10);
+	enter_bootloader();
+}
@@ -3,7 +3,9 @@
 	/* Includes: */
 		#include <avr/io.h>
 		#include <avr/wdt.h>
+		#include <avr/pgmspace.h>
 		#include <util/delay.h>
+		#include <util/crc16.h>
 
 		#include <LUFA/Common/Common.h>
 		#include <LUFA/Drivers/USB/USB.h>
@@ -13,6 +15,8 @@
 		#include <LUFA/Drivers/USB/USB.h>
 		#include <LUFA/Platform/Platform.h>
 
+		#include "Config/AppConfig.h"
+
 	/* Macros: */
 		#define MAGIC_BOOT_KEY            0xDC42ACCA
 #if (BOARD == BOARD_LEONARDO)
@@ -20,7 +24,26 @@
 #else
 		#error Unsupported board for this entering bootloader file.		
 #endif
+
+	/* Type Defines: */
+		/** Update feature report, little endian. Reading it returns the size and CRC of the running
+		 *  image, so the host can skip devices already running its image and verify an update once
+		 *  the new application is back; writing it with \ref MAGIC_BOOT_KEY resets into the bootloader.
+		 */
+		typedef struct
+		{
+			uint32_t Key; /**< \ref MAGIC_BOOT_KEY to enter the bootloader, read as zero. */
+			uint16_t ImageSize; /**< Bytes of flash taken by the application image, code and data, or
+			                     *   zero while the CRC is still being computed after reset. */
+			uint16_t ImageCRC; /**< CRC-16/CCITT of the image, as computed by \c _crc_ccitt_update()
+			                    *   starting from 0xFFFF. */
+		} __attribute__((packed)) USB_UpdateReport_t;
+
 	/* Function Prototypes: */
 		void enter_bootloader(void);
+		void Update_RequestBootloader(void);
+		void Update_ProcessReport(const USB_UpdateReport_t* const Report);
+		void Update_CreateReport(USB_UpdateReport_t* const Report);
+		void Update_Task(void);
 
 #endif
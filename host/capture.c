@@ -0,0 +1,481 @@
+/** \file
+ *
+ *  Capture tool for the firmware's raw sample stream. Every matching device gets its stream started
+ *  and several bulk transfers kept in flight with libusb's asynchronous API; completed transfers
+ *  are appended straight into a memory mapped binary trace (see tracefile.h), tagged with the
+ *  device's serial number, and resubmitted from the completion callback.
+ *
+ *  For testing without hardware, "-S N" replaces the USB devices with N synthetic panels that
+ *  produce the same packed samples through the same append path; this mode builds without libusb.
+ *
+ *    capture [-o TRACE] [-t SECONDS] [-s SERIAL]... [-S DEVICES] [-r RATE]
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if HAVE_LIBUSB
+#include <libusb.h>
+#endif
+
+#include "tracefile.h"
+
+#define VENDOR_ID                0x03EB
+#define PRODUCT_ID               0x2040
+
+/** Vendor request starting and stopping the raw stream, see VendorRequests_t in the firmware. */
+#define VENDOR_REQ_RAW_STREAM    0x04
+
+#define RAW_INTERFACE            1
+#define RAW_EPADDR               0x82
+#define RAW_EPSIZE               64
+
+/** Bulk transfers kept in flight per device. */
+#define TRANSFERS_IN_FLIGHT      8
+
+/** Size of one bulk transfer; a transfer completes early on every short packet. */
+#define TRANSFER_SIZE            (8 * RAW_EPSIZE)
+
+/** Largest number of serial numbers selectable on the command line. */
+#define MAX_SERIAL_FILTERS       TRACE_MAX_DEVICES
+
+typedef struct
+{
+	int      Index; /**< Device index in the trace. */
+	uint64_t Samples;
+#if HAVE_LIBUSB
+	libusb_device_handle*    Handle;
+	struct libusb_transfer*  Transfers[TRANSFERS_IN_FLIGHT];
+	int                      Pending; /**< Transfers currently submitted. */
+#endif
+	/* Synthetic panel state */
+	uint64_t SyntheticFrames;
+	unsigned Phase;
+} capture_device_t;
+
+static TraceWriter_t    trace;
+static capture_device_t devices[TRACE_MAX_DEVICES];
+static int              device_count;
+static uint64_t         start_ns;
+static volatile bool    stopping;
+
+static uint64_t Now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void Stop(int signal)
+{
+	(void)signal;
+	stopping = true;
+}
+
+/** Appends the packed samples of one received packet or transfer to the trace. */
+static void AppendSamples(capture_device_t* const device, const uint8_t* const data, const size_t length)
+{
+	size_t count = (length / TRACE_SAMPLE_SIZE);
+
+	if (!count)
+	  return;
+
+	TraceRecord_t* record = TraceWriter_Reserve(&trace, count);
+	if (!record)
+	{
+		perror("trace");
+		stopping = true;
+		return;
+	}
+
+	uint64_t host_time = (Now() - start_ns);
+
+	for (size_t i = 0; i < count; i++, record++)
+	{
+		record->HostTime = host_time;
+		record->Device   = device->Index;
+		memcpy(record->Sample, data + i * TRACE_SAMPLE_SIZE, TRACE_SAMPLE_SIZE);
+	}
+
+	TraceWriter_Commit(&trace);
+	device->Samples += count;
+}
+
+static int AddDevice(const char* const serial)
+{
+	int index = TraceWriter_AddDevice(&trace, serial);
+
+	if (index < 0)
+	{
+		fprintf(stderr, "%s: more than %d devices, ignored\n", serial, TRACE_MAX_DEVICES);
+		return -1;
+	}
+
+	memset(&devices[device_count], 0, sizeof(devices[device_count]));
+	devices[device_count].Index = index;
+	return device_count++;
+}
+
+/** Synthesizes the scan frames of a panel up to the current time: a finger circling at 1 Hz for
+ *  600 ms of every second, with standby readouts following the firmware's plate resistance model.
+ */
+static void Synthesize(capture_device_t* const device, const unsigned rate, const uint64_t now)
+{
+	uint8_t  packet[RAW_EPSIZE];
+	size_t   length = 0;
+	uint64_t due    = (now - start_ns) * rate / 1000000000;
+
+	while (device->SyntheticFrames < due)
+	{
+		uint64_t      frame = device->SyntheticFrames++;
+		double        t     = (double)frame / rate;
+		TraceSample_t s     = {.Stamp = (uint16_t)(uint64_t)(t * 1000000)};
+
+		if (fmod(t, 1.0) < 0.6)
+		{
+			double angle = 2 * M_PI * (t + device->Phase * 0.1);
+
+			s.X       = 512 + 300 * cos(angle);
+			s.Y       = 512 + 300 * sin(angle);
+			s.STBY_XR = 300;
+			s.STBY_YD = 300 + 150 * 300 / s.X;
+			s.Flags   = 1;
+		}
+		else
+		{
+			s.X       = 1023;
+			s.STBY_YD = 1023;
+		}
+
+		TraceSample_Encode(&s, packet + length);
+		length += TRACE_SAMPLE_SIZE;
+
+		if (length == sizeof(packet))
+		{
+			AppendSamples(device, packet, length);
+			length = 0;
+		}
+	}
+
+	AppendSamples(device, packet, length);
+}
+
+static int RunSynthetic(const int count, const unsigned rate, const double seconds)
+{
+	char serial[TRACE_SERIAL_LENGTH];
+
+	for (int i = 0; i < count; i++)
+	{
+		snprintf(serial, sizeof(serial), "SYN-%04d", i + 1);
+		if (AddDevice(serial) < 0)
+		  break;
+		devices[i].Phase = i;
+	}
+
+	const struct timespec tick = {.tv_nsec = 1000000};
+
+	while (!stopping)
+	{
+		uint64_t now = Now();
+
+		for (int i = 0; i < device_count; i++)
+		  Synthesize(&devices[i], rate, now);
+
+		if (seconds && ((now - start_ns) >= seconds * 1e9))
+		  break;
+
+		nanosleep(&tick, NULL);
+	}
+
+	return 0;
+}
+
+#if HAVE_LIBUSB
+static void LIBUSB_CALL TransferComplete(struct libusb_transfer* transfer)
+{
+	capture_device_t* device = transfer->user_data;
+
+	device->Pending--;
+
+	switch (transfer->status)
+	{
+		case LIBUSB_TRANSFER_COMPLETED:
+			AppendSamples(device, transfer->buffer, transfer->actual_length);
+			break;
+		case LIBUSB_TRANSFER_CANCELLED:
+			return;
+		case LIBUSB_TRANSFER_NO_DEVICE:
+			fprintf(stderr, "%s: disconnected\n", trace.Header->Serials[device->Index]);
+			trace.Header->Errors[device->Index]++;
+			return;
+		default:
+			trace.Header->Errors[device->Index]++;
+			break;
+	}
+
+	if (!stopping && (libusb_submit_transfer(transfer) == 0))
+	  device->Pending++;
+}
+
+static bool SerialSelected(const char* const serial, char** const filters, const int filter_count)
+{
+	if (!filter_count)
+	  return true;
+
+	for (int i = 0; i < filter_count; i++)
+	{
+		if (!strcmp(serial, filters[i]))
+		  return true;
+	}
+
+	return false;
+}
+
+static int OpenDevices(libusb_context* const usb, char** const filters, const int filter_count)
+{
+	libusb_device** list;
+	ssize_t         count = libusb_get_device_list(usb, &list);
+
+	for (ssize_t i = 0; i < count; i++)
+	{
+		struct libusb_device_descriptor descriptor;
+		libusb_device_handle*           handle;
+		char                            serial[TRACE_SERIAL_LENGTH] = "";
+
+		if (libusb_get_device_descriptor(list[i], &descriptor) ||
+		    (descriptor.idVendor != VENDOR_ID) || (descriptor.idProduct != PRODUCT_ID))
+		  continue;
+
+		if (libusb_open(list[i], &handle))
+		  continue;
+
+		if (descriptor.iSerialNumber)
+		  libusb_get_string_descriptor_ascii(handle, descriptor.iSerialNumber, (uint8_t*)serial, sizeof(serial));
+
+		if (!SerialSelected(serial, filters, filter_count) || libusb_claim_interface(handle, RAW_INTERFACE))
+		{
+			libusb_close(handle);
+			continue;
+		}
+
+		int d = AddDevice(serial);
+		if (d < 0)
+		{
+			libusb_release_interface(handle, RAW_INTERFACE);
+			libusb_close(handle);
+			break;
+		}
+
+		devices[d].Handle = handle;
+	}
+
+	libusb_free_device_list(list, 1);
+	return device_count;
+}
+
+static int StartDevice(capture_device_t* const device)
+{
+	const uint8_t request_type = (LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_OUT);
+
+	if (libusb_control_transfer(device->Handle, request_type, VENDOR_REQ_RAW_STREAM, 1, 0, NULL, 0, 1000) < 0)
+	  return -1;
+
+	for (int i = 0; i < TRANSFERS_IN_FLIGHT; i++)
+	{
+		struct libusb_transfer* transfer = libusb_alloc_transfer(0);
+		uint8_t*                buffer   = malloc(TRANSFER_SIZE);
+
+		if (!transfer || !buffer)
+		  return -1;
+
+		libusb_fill_bulk_transfer(transfer, device->Handle, RAW_EPADDR, buffer, TRANSFER_SIZE,
+		                          TransferComplete, device, 0);
+		transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+
+		if (libusb_submit_transfer(transfer))
+		{
+			libusb_free_transfer(transfer);
+			return -1;
+		}
+
+		device->Transfers[i] = transfer;
+		device->Pending++;
+	}
+
+	return 0;
+}
+
+/** Stops a device's stream, waits for its transfers to retire and records its overflow count. */
+static void StopDevice(libusb_context* const usb, capture_device_t* const device)
+{
+	const uint8_t request_type = (LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE);
+	uint8_t       status[3];
+
+	for (int i = 0; i < TRANSFERS_IN_FLIGHT; i++)
+	{
+		if (device->Transfers[i])
+		  libusb_cancel_transfer(device->Transfers[i]);
+	}
+
+	while (device->Pending > 0)
+	  libusb_handle_events(usb);
+
+	for (int i = 0; i < TRANSFERS_IN_FLIGHT; i++)
+	  libusb_free_transfer(device->Transfers[i]);
+
+	libusb_control_transfer(device->Handle, request_type | LIBUSB_ENDPOINT_OUT, VENDOR_REQ_RAW_STREAM, 0, 0,
+	                        NULL, 0, 1000);
+	if (libusb_control_transfer(device->Handle, request_type | LIBUSB_ENDPOINT_IN, VENDOR_REQ_RAW_STREAM, 0, 0,
+	                            status, sizeof(status), 1000) == sizeof(status))
+	  trace.Header->Overflows[device->Index] = status[1] | (status[2] << 8);
+
+	libusb_release_interface(device->Handle, RAW_INTERFACE);
+	libusb_close(device->Handle);
+}
+
+static int RunUSB(char** const filters, const int filter_count, const double seconds)
+{
+	libusb_context* usb;
+
+	if (libusb_init(&usb))
+	{
+		fprintf(stderr, "libusb initialization failed\n");
+		return 1;
+	}
+
+	if (!OpenDevices(usb, filters, filter_count))
+	{
+		fprintf(stderr, "no device found\n");
+		libusb_exit(usb);
+		return 1;
+	}
+
+	for (int i = 0; i < device_count; i++)
+	{
+		if (StartDevice(&devices[i]) < 0)
+		  fprintf(stderr, "%s: stream did not start\n", trace.Header->Serials[devices[i].Index]);
+	}
+
+	while (!stopping)
+	{
+		struct timeval timeout = {.tv_usec = 100000};
+
+		libusb_handle_events_timeout_completed(usb, &timeout, NULL);
+
+		if (seconds && ((Now() - start_ns) >= seconds * 1e9))
+		  break;
+	}
+
+	stopping = true;
+	for (int i = 0; i < device_count; i++)
+	  StopDevice(usb, &devices[i]);
+
+	libusb_exit(usb);
+	return 0;
+}
+#endif
+
+static void Usage(const char* const name)
+{
+	fprintf(stderr, "usage: %s [-o TRACE] [-t SECONDS] [-s SERIAL]... [-S DEVICES] [-r RATE]\n"
+	                "  -o  output trace file, default capture.trace\n"
+	                "  -t  capture duration in seconds, default until interrupted\n"
+	                "  -s  capture only the device with this serial number, repeatable\n"
+	                "  -S  capture this many synthetic panels instead of USB devices\n"
+	                "  -r  synthetic scan rate in frames per second, default 1200\n", name);
+	exit(2);
+}
+
+int main(int argc, char** argv)
+{
+	const char* path             = "capture.trace";
+	double      seconds          = 0;
+	int         synthetic        = 0;
+	unsigned    rate             = 1200;
+	char*       filters[MAX_SERIAL_FILTERS];
+	int         filter_count     = 0;
+	int         option;
+
+	while ((option = getopt(argc, argv, "o:t:s:S:r:")) != -1)
+	{
+		switch (option)
+		{
+			case 'o':
+				path = optarg;
+				break;
+			case 't':
+				seconds = atof(optarg);
+				break;
+			case 's':
+				if (filter_count < MAX_SERIAL_FILTERS)
+				  filters[filter_count++] = optarg;
+				break;
+			case 'S':
+				synthetic = atoi(optarg);
+				break;
+			case 'r':
+				rate = atoi(optarg);
+				break;
+			default:
+				Usage(argv[0]);
+		}
+	}
+
+	if ((optind != argc) || (synthetic < 0) || !rate)
+	  Usage(argv[0]);
+
+	if (TraceWriter_Create(&trace, path) < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	signal(SIGINT, Stop);
+	signal(SIGTERM, Stop);
+	start_ns = Now();
+
+	int result;
+
+	if (synthetic)
+	{
+		result = RunSynthetic(synthetic, rate, seconds);
+	}
+	else
+	{
+#if HAVE_LIBUSB
+		result = RunUSB(filters, filter_count, seconds);
+#else
+		(void)filters;
+		fprintf(stderr, "built without libusb, only synthetic capture (-S) is available\n");
+		result = 1;
+#endif
+	}
+
+	double elapsed = (Now() - start_ns) / 1e9;
+
+	for (int i = 0; i < device_count; i++)
+	{
+		fprintf(stderr, "%s: %llu samples, %.0f/s, %u overflows, %u transfer errors\n",
+		        trace.Header->Serials[devices[i].Index], (unsigned long long)devices[i].Samples,
+		        devices[i].Samples / elapsed, trace.Header->Overflows[devices[i].Index],
+		        trace.Header->Errors[devices[i].Index]);
+	}
+
+	if (TraceWriter_Close(&trace) < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	return result;
+}
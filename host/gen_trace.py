@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Generates the synthetic raw ADC traces in traces/ for the replay harness.
+
+Every line is one scan frame "Y X STBY_YD STBY_XR" of 10-bit conversion results, followed on
+touched frames by the noise free "Y X" position as ground truth for the replay's error figures. A touch at
+(x, y) with plate resistance r reads back through the pressure test as
+r = x * (STBY_YD / STBY_XR - 1); an untouched panel reads STBY_XR as 0. Untouched sense pins
+float and keep the level they were last driven to: low for Y, high for X.
+"""
+
+import os, random
+
+STBY_XR = 300
+
+def floating(rng):
+    return (rng.randrange(4), 1023 - rng.randrange(4))
+
+def idle(rng, n):
+    return [floating(rng) + (1023, 0) for _ in range(n)]
+
+def touch(rng, x, y, r, noise):
+    sx = min(1023, max(1, int(round(x + rng.uniform(-noise, noise)))))
+    sy = min(1023, max(0, int(round(y + rng.uniform(-noise, noise)))))
+    yd = min(1023, STBY_XR + int(r * STBY_XR / sx))
+    return (sy, sx, yd, STBY_XR, y, x)
+
+def tap(rng):
+    frames = idle(rng, 10)
+    frames += [touch(rng, 512, 300, 150, 3) for _ in range(20)]
+    # A single sample spike, the contact itself stays put
+    frames.append(touch(rng, 900, 40, 150, 0)[:4] + (300, 512))
+    frames += [touch(rng, 512, 300, 150, 3) for _ in range(20)]
+    return frames + idle(rng, 10)
+
+def swipe(rng):
+    frames = idle(rng, 10)
+    frames += [touch(rng, 100 + 800 * i / 59, 600, 200, 2) for i in range(60)]
+    return frames + idle(rng, 10)
+
+def light(rng):
+    frames = idle(rng, 5)
+    frames += [touch(rng, 700, 700, rng.choice((420, 480, 520, 580)), 2) for _ in range(40)]
+    return frames + idle(rng, 5)
+
+def bounce(rng):
+    # Contacts that start after the X phase of a frame, leaving floating coordinates, then a
+    # light first contact that is only trusted once a second frame confirms it
+    frames = idle(rng, 5)
+    frames.append(floating(rng) + touch(rng, 400, 400, 100, 0)[2:4])
+    frames += [touch(rng, 400, 400, 100, 2) for _ in range(10)]
+    frames += idle(rng, 5)
+    frames += [touch(rng, 600, 200, 400, 2) for _ in range(10)]
+    return frames + idle(rng, 5)
+
+def main():
+    out = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'traces')
+    for seed, gen in enumerate((tap, swipe, light, bounce)):
+        rng = random.Random(seed)
+        with open(os.path.join(out, gen.__name__ + '.trace'), 'w') as f:
+            f.write('# %s, generated by gen_trace.py\n' % gen.__name__)
+            for frame in gen(rng):
+                f.write(('%d %d %d %d' + ' %.1f %.1f' * (len(frame) > 4) + '\n') % frame)
+
+if __name__ == '__main__':
+    main()
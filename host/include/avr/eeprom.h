@@ -0,0 +1,43 @@
+/** \file
+ *
+ *  Host stand-in for <avr/eeprom.h>. EEMEM variables live in ordinary memory and start out zeroed,
+ *  which no valid record matches, just like an erased part.
+ */
+
+#ifndef _MOCK_AVR_EEPROM_H_
+#define _MOCK_AVR_EEPROM_H_
+
+	/* Includes: */
+		#include <stdint.h>
+		#include <string.h>
+
+	/* Macros: */
+		#define EEMEM
+
+	/* Inline Functions: */
+		static inline int eeprom_is_ready(void)
+		{
+			return 1;
+		}
+
+		static inline void eeprom_read_block(void* const dst, const void* const src, const size_t n)
+		{
+			memcpy(dst, src, n);
+		}
+
+		static inline void eeprom_update_block(const void* const src, void* const dst, const size_t n)
+		{
+			memmove(dst, src, n);
+		}
+
+		static inline uint8_t eeprom_read_byte(const uint8_t* const address)
+		{
+			return *address;
+		}
+
+		static inline void eeprom_update_byte(uint8_t* const address, const uint8_t value)
+		{
+			*address = value;
+		}
+
+#endif
@@ -0,0 +1,16 @@
+/** \file
+ *
+ *  Host stand-in for <avr/interrupt.h>. Interrupt handlers become plain functions which the
+ *  replay harness calls directly.
+ */
+
+#ifndef _MOCK_AVR_INTERRUPT_H_
+#define _MOCK_AVR_INTERRUPT_H_
+
+	/* Macros: */
+		#define ISR(vector, ...)  void vector(void)
+
+		#define sei()
+		#define cli()
+
+#endif
@@ -0,0 +1,103 @@
+/** \file
+ *
+ *  Host stand-in for <avr/io.h>. Every register the touch pipeline uses is a plain variable, and
+ *  each access through the register name bumps \ref mock_io_accesses so the replay harness can
+ *  report per-sample register traffic.
+ */
+
+#ifndef _MOCK_AVR_IO_H_
+#define _MOCK_AVR_IO_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+	/* Macros: */
+		#define _BV(bit)          (1 << (bit))
+
+		#define MOCK_REG(name)    (*({ mock_io_accesses++; &mock_##name; }))
+
+		#define ADMUX             MOCK_REG(ADMUX)
+		#define ADCSRA            MOCK_REG(ADCSRA)
+		#define ADCSRB            MOCK_REG(ADCSRB)
+		#define ADC               MOCK_REG(ADC)
+		#define DIDR0             MOCK_REG(DIDR0)
+		#define DIDR2             MOCK_REG(DIDR2)
+		#define PORTF             MOCK_REG(PORTF)
+		#define DDRF              MOCK_REG(DDRF)
+		#define PORTB             MOCK_REG(PORTB)
+		#define DDRB              MOCK_REG(DDRB)
+		#define TCCR1A            MOCK_REG(TCCR1A)
+		#define TCCR1B            MOCK_REG(TCCR1B)
+		#define TCNT1             MOCK_REG(TCNT1)
+		#define TCCR3A            MOCK_REG(TCCR3A)
+		#define TCCR3B            MOCK_REG(TCCR3B)
+		#define TCNT3             MOCK_REG(TCNT3)
+		#define ACSR              MOCK_REG(ACSR)
+
+		/* ADMUX */
+		#define REFS1             7
+		#define REFS0             6
+		#define ADLAR             5
+
+		/* ADCSRA */
+		#define ADEN              7
+		#define ADSC              6
+		#define ADATE             5
+		#define ADIF              4
+		#define ADIE              3
+		#define ADPS2             2
+		#define ADPS1             1
+		#define ADPS0             0
+
+		/* ADCSRB */
+		#define ADHSM             7
+		#define ACME              6
+		#define MUX5              5
+
+		/* ACSR */
+		#define ACD               7
+		#define ACBG              6
+		#define ACO               5
+		#define ACI               4
+		#define ACIE              3
+		#define ACIC              2
+		#define ACIS1             1
+		#define ACIS0             0
+
+		/* TCCR1B */
+		#define CS12              2
+		#define CS11              1
+		#define CS10              0
+
+		/* TCCR3B */
+		#define CS30              0
+
+		#define ADC_vect          mock_ADC_vect
+		#define ANALOG_COMP_vect  mock_ANALOG_COMP_vect
+
+	/* External Variables: */
+		extern unsigned long mock_io_accesses;
+
+		extern uint8_t  mock_ADMUX;
+		extern uint8_t  mock_ADCSRA;
+		extern uint8_t  mock_ADCSRB;
+		extern uint16_t mock_ADC;
+		extern uint8_t  mock_DIDR0;
+		extern uint8_t  mock_DIDR2;
+		extern uint8_t  mock_PORTF;
+		extern uint8_t  mock_DDRF;
+		extern uint8_t  mock_PORTB;
+		extern uint8_t  mock_DDRB;
+		extern uint8_t  mock_TCCR1A;
+		extern uint8_t  mock_TCCR1B;
+		extern uint16_t mock_TCNT1;
+		extern uint8_t  mock_TCCR3A;
+		extern uint8_t  mock_TCCR3B;
+		extern uint16_t mock_TCNT3;
+		extern uint8_t  mock_ACSR;
+
+	/* Function Prototypes: */
+		void mock_ADC_vect(void);
+		void mock_ANALOG_COMP_vect(void);
+
+#endif
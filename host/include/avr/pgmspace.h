@@ -0,0 +1,18 @@
+/** \file
+ *
+ *  Host stand-in for <avr/pgmspace.h>. Flash tables are ordinary constant data on the host.
+ */
+
+#ifndef _MOCK_AVR_PGMSPACE_H_
+#define _MOCK_AVR_PGMSPACE_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+	/* Macros: */
+		#define PROGMEM
+
+		#define pgm_read_byte(address)  (*(const uint8_t*)(address))
+		#define pgm_read_word(address)  (*(const uint16_t*)(address))
+
+#endif
@@ -0,0 +1,16 @@
+/** \file
+ *
+ *  Host stand-in for <util/atomic.h>. The harness is single threaded, so atomic blocks only
+ *  need to keep their block semantics.
+ */
+
+#ifndef _MOCK_UTIL_ATOMIC_H_
+#define _MOCK_UTIL_ATOMIC_H_
+
+	/* Macros: */
+		#define ATOMIC_RESTORESTATE
+		#define ATOMIC_FORCEON
+
+		#define ATOMIC_BLOCK(type)  for (int mock_atomic_once = 1; mock_atomic_once; mock_atomic_once = 0)
+
+#endif
@@ -0,0 +1,22 @@
+/** \file
+ *
+ *  Host stand-in for <util/crc16.h>, with the reference implementations from the avr-libc manual.
+ */
+
+#ifndef _MOCK_UTIL_CRC16_H_
+#define _MOCK_UTIL_CRC16_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+	/* Inline Functions: */
+		static inline uint8_t _crc8_ccitt_update(uint8_t crc, const uint8_t data)
+		{
+			crc ^= data;
+			for (uint8_t i = 0; i < 8; i++)
+			  crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+
+			return crc;
+		}
+
+#endif
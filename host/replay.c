@@ -0,0 +1,535 @@
+/** \file
+ *
+ *  Host replay harness for the touch pipeline. Raw panel states from a trace are served to the
+ *  real scan engine through the mocked ADC, one trace line per completed scan frame, and the
+ *  resulting HID report of every frame is printed for comparison against a golden file, marked
+ *  with '*' when the HID driver would send it to the host. Time advances by one conversion time
+ *  per conversion, with a USB start of frame every millisecond.
+ *
+ *  The ADC model follows the free running hardware: a conversion latches the channel and the
+ *  panel drive when it starts, which is before the ISR of the previous conversion runs.
+ *
+ *  The raw sample stream runs alongside and every streamed sample is checked against the readouts
+ *  the scan engine saw, so a frame lost or mangled on the way is an error.
+ *
+ *  Text trace lines hold "Y X STBY_YD STBY_XR" as 10-bit conversion results of the panel state;
+ *  '#' starts a comment. Touched frames may add the true "Y X" position of the contact. The
+ *  reported position is compared against it at the time the host is expected to see it, the
+ *  prediction horizon after the scan, and the mean and largest error are printed.
+ *
+ *  Binary traces recorded by capture are replayed sample by sample, with oversampled X/Y readouts
+ *  scaled back to 10 bits. The device is selected with "-s SERIAL" and its panel with "-c PANEL",
+ *  by default the first of each.
+ *
+ *  Built with several panels, every panel is fed the same trace and the reports of the panel
+ *  selected with "-p PANEL", the first one by default, are printed.
+ *
+ *    replay [-s SERIAL] [-c PANEL] [-p PANEL] TRACE
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "touch.h"
+#include "tracefile.h"
+
+/* Electrodes of the panel model, as bits of a latched drive pattern */
+#define E_YU 0x01
+#define E_XL 0x02
+#define E_YD 0x04
+#define E_XR 0x08
+
+/** Maps port bits of panel \p n of the panel profile onto the electrode bits. */
+#define ELECTRODES(n, bits) \
+	((((bits) & _BV(PANEL##n##_PIN_YU)) ? E_YU : 0) | (((bits) & _BV(PANEL##n##_PIN_XL)) ? E_XL : 0) | \
+	 (((bits) & _BV(PANEL##n##_PIN_YD)) ? E_YD : 0) | (((bits) & _BV(PANEL##n##_PIN_XR)) ? E_XR : 0))
+
+/** Latches panel \p n if \p channel is one of its sensed electrodes. */
+#define LATCH_PANEL(n, channel) \
+	do \
+	{ \
+		uint8_t sensed = ((channel) == PANEL##n##_ADC_XL) ? E_XL : ((channel) == PANEL##n##_ADC_YD) ? E_YD : \
+		                 ((channel) == PANEL##n##_ADC_XR) ? E_XR : 0; \
+		if (sensed) \
+			return (conversion_t){.Port = ELECTRODES(n, PANEL##n##_PORT), .Ddr = ELECTRODES(n, PANEL##n##_DDR), \
+			                      .Sensed = sensed}; \
+	} while (0)
+
+unsigned long mock_io_accesses;
+
+uint8_t  mock_ADMUX;
+uint8_t  mock_ADCSRA;
+uint8_t  mock_ADCSRB;
+uint16_t mock_ADC;
+uint8_t  mock_DIDR0;
+uint8_t  mock_DIDR2;
+uint8_t  mock_PORTF;
+uint8_t  mock_DDRF;
+uint8_t  mock_PORTB;
+uint8_t  mock_DDRB;
+uint8_t  mock_TCCR1A;
+uint8_t  mock_TCCR1B;
+uint16_t mock_TCNT1;
+uint8_t  mock_TCCR3A;
+uint8_t  mock_TCCR3B;
+uint16_t mock_TCNT3;
+uint8_t  mock_ACSR;
+
+typedef struct
+{
+	uint8_t Port; /**< Electrodes driven high. */
+	uint8_t Ddr; /**< Electrodes driven. */
+	uint8_t Sensed; /**< Electrode on the sense channel, 0 if none. */
+} conversion_t;
+
+typedef struct
+{
+	unsigned Y;
+	unsigned X;
+	unsigned STBY_YD;
+	unsigned STBY_XR;
+	bool     Truth; /**< Whether the true position below is known. */
+	double   TrueY;
+	double   TrueX;
+} panel_t;
+
+/** Reported and true position of a replayed frame. */
+typedef struct
+{
+	bool   Pressed;
+	bool   Truth;
+	double Y;
+	double X;
+	double TrueY;
+	double TrueX;
+} position_t;
+
+/** Trace being replayed, either a text trace or a binary capture. */
+typedef struct
+{
+	FILE*         Text;
+	TraceReader_t Binary;
+	int           Device; /**< Replayed device of a binary trace. */
+	uint8_t       Panel; /**< Replayed panel of the device. */
+	uint64_t      Next; /**< Next record of a binary trace. */
+} source_t;
+
+/** Returns the duration of one free running conversion, 13 ADC clocks, in nanoseconds. */
+static unsigned long ConversionTime(void)
+{
+	uint8_t prescaler = (mock_ADCSRA & 0x07);
+
+	return 13 * 1000000000ULL * (prescaler ? (1 << prescaler) : 2) / F_CPU;
+}
+
+/** Latches the sense channel and the drive of the panel it belongs to, through the wiring of the
+ *  panel profile.
+ */
+static conversion_t Latch(void)
+{
+	uint8_t channel = (mock_ADMUX & 0x1F) + ((mock_ADCSRB & _BV(MUX5)) ? 8 : 0);
+
+	LATCH_PANEL(0, channel);
+#if (TOUCH_PANELS > 1)
+	LATCH_PANEL(1, channel);
+#endif
+
+	return (conversion_t){.Port = 0, .Ddr = 0, .Sensed = 0};
+}
+
+/** Returns the 10-bit conversion result the panel presents for a drive pattern and sensed electrode.
+ *  A trace's Y grows towards YU and its X towards XR, whichever polarity the plate is driven with.
+ *  Patterns the scan engine should never sample read as a floating zero.
+ */
+static uint16_t Sample(const conversion_t* const c, const panel_t* const panel)
+{
+	if ((c->Ddr == (E_YU | E_YD)) && (c->Sensed & (E_XL | E_XR)))
+	  return (c->Port == E_YU) ? panel->Y : (c->Port == E_YD) ? (1023 - panel->Y) : 0;
+	if ((c->Ddr == (E_XL | E_XR)) && (c->Sensed & (E_YU | E_YD)))
+	  return (c->Port == E_XR) ? panel->X : (c->Port == E_XL) ? (1023 - panel->X) : 0;
+	if ((c->Ddr == (E_YU | E_XL)) && (c->Port == E_YU) && (c->Sensed == E_YD))
+	  return panel->STBY_YD;
+	if ((c->Ddr == (E_YU | E_XL)) && (c->Port == E_YU) && (c->Sensed == E_XR))
+	  return panel->STBY_XR;
+
+	return 0;
+}
+
+#if TOUCH_IDLE_DETECT
+/** Lets one frame of the trace pass while the scan engine is idle. A contact trips the analog
+ *  comparator if the panel is biased for it: the X plane held low, the Y plane pulled up and sensed
+ *  on YD against the bandgap. Otherwise a frame period of USB start of frames passes.
+ *
+ *  \return Whether the scan engine is running again.
+ */
+static bool Detect(const panel_t* const panel, unsigned long* const now_ns)
+{
+	conversion_t c       = Latch();
+	bool         contact = (c.Ddr == E_XL) && (c.Port == E_YU) && (c.Sensed == E_YD) &&
+	                       (mock_ADCSRB & _BV(ACME)) && (mock_ACSR & _BV(ACBG)) && panel->STBY_XR;
+
+	mock_ACSR = contact ? (mock_ACSR | _BV(ACO)) : (mock_ACSR & ~_BV(ACO));
+
+	if (contact && (mock_ACSR & _BV(ACIE)))
+	{
+		mock_ANALOG_COMP_vect();
+	}
+	else
+	{
+		for (*now_ns += TOUCH_SCAN_PERIOD_US * 1000; *now_ns >= 1000000; *now_ns -= 1000000)
+		  Touch_MillisecondElapsed();
+		mock_TCNT1 += TOUCH_SCAN_PERIOD_US;
+		mock_TCNT3 += TOUCH_SCAN_PERIOD_US * (F_CPU / 1000000);
+	}
+
+	return (mock_ADCSRA & _BV(ADEN));
+}
+#endif
+
+#if TOUCH_RAW_STREAM
+/** Drains all queued raw samples, checking that each carries the standby readouts of the panel.
+ *
+ *  \return Number of samples drained.
+ */
+static unsigned long DrainRawStream(const panel_t* const panel)
+{
+	uint8_t       packet[RAW_STREAM_PACKET_SAMPLES * RAW_STREAM_SAMPLE_SIZE];
+	unsigned long samples = 0;
+	uint8_t       length;
+
+	/* Force partial packets out by passing the flush delay */
+	for (uint8_t ms = 0; ms < RAW_STREAM_FLUSH_MS; ms++)
+	  RawStream_MillisecondElapsed();
+
+	while ((length = RawStream_ReadPacket(packet)))
+	{
+		for (uint8_t* s = packet; s < (packet + length); s += RAW_STREAM_SAMPLE_SIZE)
+		{
+			unsigned yd = s[5] | ((s[6] & 0x03) << 8);
+			unsigned xr = (s[6] >> 2) | ((s[7] & 0x0F) << 6);
+
+			/* Every panel is fed the same trace and streams a sample per frame, in panel order */
+			if ((s[0] & RAW_STREAM_STAMP_PANEL) != (samples % TOUCH_PANELS))
+			{
+				fprintf(stderr, "raw sample of panel %u out of order\n", s[0] & RAW_STREAM_STAMP_PANEL);
+				exit(1);
+			}
+
+			if ((yd != panel->STBY_YD) || (xr != panel->STBY_XR))
+			{
+				fprintf(stderr, "raw sample %u/%u does not match the panel %u/%u\n", yd, xr,
+				        panel->STBY_YD, panel->STBY_XR);
+				exit(1);
+			}
+
+			samples++;
+		}
+	}
+
+	return samples;
+}
+#endif
+
+static int OpenSource(source_t* const source, const char* const path, const char* const serial,
+                      const uint8_t captured)
+{
+	memset(source, 0, sizeof(*source));
+	source->Panel = captured;
+
+	if (TraceReader_Open(&source->Binary, path) == 0)
+	{
+		source->Device = serial ? TraceReader_FindDevice(&source->Binary, serial) : 0;
+		if (source->Device < 0)
+		{
+			fprintf(stderr, "%s: no device %s in trace\n", path, serial);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	if (errno != EINVAL)
+	{
+		perror(path);
+		return -1;
+	}
+
+	source->Text = fopen(path, "r");
+	if (!source->Text)
+	{
+		perror(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void CloseSource(source_t* const source)
+{
+	if (source->Text)
+	  fclose(source->Text);
+	else
+	  TraceReader_Close(&source->Binary);
+}
+
+static int ReadRecord(source_t* const source, panel_t* const panel)
+{
+	while (source->Next < source->Binary.Count)
+	{
+		const TraceRecord_t* record = &source->Binary.Records[source->Next++];
+		TraceSample_t        sample;
+
+		if (record->Device != source->Device)
+		  continue;
+
+		TraceSample_Decode(record->Sample, &sample);
+		if (sample.Panel != source->Panel)
+		  continue;
+
+		uint8_t oversample = (sample.Flags >> RAW_STREAM_FLAG_OVERSAMPLE_SHIFT) & 0x03;
+
+		panel->Y       = (sample.Y >> oversample);
+		panel->X       = (sample.X >> oversample);
+		panel->STBY_YD = sample.STBY_YD;
+		panel->STBY_XR = sample.STBY_XR;
+		panel->Truth   = false;
+		return 1;
+	}
+
+	return 0;
+}
+
+/** Prints the mean and largest distance between the reported positions and the true positions one
+ *  prediction horizon later, interpolated between frames. Frames scan back to back, so the horizon
+ *  is a fixed number of frames.
+ */
+static void PrintError(const char* const path, const position_t* const positions, const unsigned long count)
+{
+	const double  horizon = (double)TOUCH_PREDICT_HORIZON_US / TOUCH_SCAN_PERIOD_US;
+	const double  scale   = (1 << TOUCH_OVERSAMPLE_BITS);
+	double        sum     = 0;
+	double        worst   = 0;
+	unsigned long n       = 0;
+
+	for (unsigned long i = 0; i < count; i++)
+	{
+		unsigned long j = i + (unsigned long)horizon;
+		double        f = horizon - (unsigned long)horizon;
+
+		if (!positions[i].Pressed || ((j + 1) >= count) || !positions[j].Truth || !positions[j + 1].Truth)
+		  continue;
+
+		double y  = positions[j].TrueY + f * (positions[j + 1].TrueY - positions[j].TrueY);
+		double x  = positions[j].TrueX + f * (positions[j + 1].TrueX - positions[j].TrueX);
+		double dy = (positions[i].Y / scale) - y;
+		double dx = (positions[i].X / scale) - x;
+		double e  = sqrt(dx * dx + dy * dy);
+
+		sum += e;
+		if (e > worst)
+		  worst = e;
+		n++;
+	}
+
+	if (n)
+	{
+		fprintf(stderr, "%s: position error %.2f/%.2f counts mean/max at %u us after the scan\n", path,
+		        sum / n, worst, (unsigned)TOUCH_PREDICT_HORIZON_US);
+	}
+}
+
+static int ReadPanel(source_t* const source, panel_t* const panel)
+{
+	char line[256];
+
+	if (!source->Text)
+	  return ReadRecord(source, panel);
+
+	while (fgets(line, sizeof(line), source->Text))
+	{
+		if ((line[0] == '#') || (line[0] == '\n'))
+		  continue;
+
+		int fields = sscanf(line, "%u %u %u %u %lf %lf", &panel->Y, &panel->X, &panel->STBY_YD, &panel->STBY_XR,
+		                    &panel->TrueY, &panel->TrueX);
+
+		panel->Truth = (fields == 6);
+		if ((fields == 4) || (fields == 6))
+		  return 1;
+
+		fprintf(stderr, "malformed trace line: %s", line);
+		exit(2);
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* serial   = NULL;
+	unsigned    shown    = 0;
+	unsigned    captured = 0;
+	bool        usage  = false;
+	int         option;
+
+	while ((option = getopt(argc, argv, "s:c:p:")) != -1)
+	{
+		if (option == 's')
+		  serial = optarg;
+		else if (option == 'c')
+		  captured = strtoul(optarg, NULL, 0);
+		else if (option == 'p')
+		  shown = strtoul(optarg, NULL, 0);
+		else
+		  usage = true;
+	}
+
+	if (usage || (optind != (argc - 1)) || (shown >= TOUCH_PANELS) || (captured > 1))
+	{
+		fprintf(stderr, "usage: %s [-s SERIAL] [-c PANEL] [-p PANEL] TRACE\n", argv[0]);
+		return 2;
+	}
+
+	const char* path = argv[optind];
+	source_t    trace;
+
+	if (OpenSource(&trace, path, serial, captured) < 0)
+	  return 2;
+
+	panel_t       panel;
+	position_t*   positions   = NULL;
+	unsigned long frames      = 0;
+	unsigned long scanned     = 0;
+	unsigned long conversions = 0;
+	unsigned long accesses    = 0;
+	unsigned long reports     = 0;
+	unsigned long now_ns      = 0;
+
+	USB_TouchReport_Data_t previous;
+	memset(&previous, 0, sizeof(previous));
+	clock_t       start       = clock();
+
+	Settings_Init();
+	Calibration_Load();
+	Touch_Init();
+	Latency_Reset();
+	conversion_t running = Latch();
+
+#if TOUCH_RAW_STREAM
+	unsigned long streamed = 0;
+	RawStream_Start();
+#endif
+
+	while (ReadPanel(&trace, &panel))
+	{
+		bool scan = true;
+
+#if TOUCH_IDLE_DETECT
+		if (!(mock_ADCSRA & _BV(ADEN)))
+		{
+			scan    = Detect(&panel, &now_ns);
+			running = Latch();
+		}
+#endif
+
+		if (scan)
+		{
+			do
+			{
+				mock_ADC = Sample(&running, &panel);
+				running  = Latch();
+
+				unsigned long before = mock_io_accesses;
+				mock_ADC_vect();
+				accesses += mock_io_accesses - before;
+				conversions++;
+
+				/* USB start of frames passing during the conversion */
+				for (now_ns += ConversionTime(); now_ns >= 1000000; now_ns -= 1000000)
+				  Touch_MillisecondElapsed();
+				mock_TCNT1 += ConversionTime() / 1000;
+				mock_TCNT3 += ConversionTime() * (F_CPU / 1000000) / 1000;
+			}
+			while (!Touch_Task());
+			scanned++;
+
+#if TOUCH_RAW_STREAM
+			streamed += DrainRawStream(&panel);
+#endif
+		}
+
+		USB_TouchReport_Data_t report;
+		bool force = false;
+
+		for (uint8_t p = 0; p < TOUCH_PANELS; p++)
+		{
+			USB_TouchReport_Data_t other;
+
+			if (p == shown)
+			{
+				memset(&report, 0, sizeof(report));
+				force = Touch_CreateReport(p, &report, true);
+			}
+			else
+			{
+				Touch_CreateReport(p, &other, true);
+			}
+		}
+		/* The host collects every report right away */
+		for (uint8_t p = 0; p < TOUCH_PANELS; p++)
+		  Latency_EndpointPolled(p, 0);
+		bool sent  = force || memcmp(&report, &previous, sizeof(report));
+
+		previous = report;
+		if (sent)
+		  reports++;
+
+		printf("%u %u %u %u %u%s\n", report.Flags, report.X, report.Y, report.Pressure, report.ScanTime,
+		       sent ? " *" : "");
+		positions = realloc(positions, (frames + 1) * sizeof(position_t));
+		positions[frames] = (position_t){.Pressed = (report.Flags & TOUCH_REPORT_TIP), .Truth = panel.Truth,
+		                                 .Y = report.Y, .X = report.X, .TrueY = panel.TrueY, .TrueX = panel.TrueX};
+		frames++;
+	}
+
+#if TOUCH_RAW_STREAM
+	if (streamed != (scanned * TOUCH_PANELS))
+	{
+		fprintf(stderr, "%s: %lu raw samples streamed for %lu frames\n", path, streamed, scanned);
+		return 1;
+	}
+#endif
+
+	double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	CloseSource(&trace);
+
+	if (frames)
+	{
+		fprintf(stderr, "%s: %lu frames, %lu scanned, %lu reports sent, %.1f conversions/frame, %.1f register accesses/frame, %.0f ns/frame\n",
+		        path, frames, scanned, reports, (double)conversions / frames, (double)accesses / frames,
+		        elapsed * 1e9 / frames);
+	}
+
+	PrintError(path, positions, frames);
+	free(positions);
+
+#if TOUCH_LATENCY_STATS
+	const Latency_Stats_t* latency = Latency_GetStats();
+
+	if (latency->Samples)
+	{
+		fprintf(stderr, "%s: scan to report latency %u/%u/%u us min/avg/max\n", path,
+		        latency->Min[LATENCY_STAGE_TOTAL],
+		        (unsigned)(latency->Sum[LATENCY_STAGE_TOTAL] / latency->Samples),
+		        latency->Max[LATENCY_STAGE_TOTAL]);
+	}
+#endif
+
+	return 0;
+}
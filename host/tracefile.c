@@ -0,0 +1,204 @@
+/** \file
+ *
+ *  Memory mapped writer and reader of the binary capture trace format. The writer grows the file
+ *  in large steps and remaps it, so appending a record is a store into the mapping rather than a
+ *  system call; the file is cut back to its committed length when closed.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tracefile.h"
+
+/** File growth step of the writer in bytes. */
+#define TRACE_GROW_SIZE    (16UL << 20)
+
+_Static_assert(sizeof(TraceHeader_t) <= TRACE_HEADER_SIZE, "trace header too large");
+_Static_assert(sizeof(TraceRecord_t) == 24, "trace record layout changed");
+
+static int Grow(TraceWriter_t* const writer, const size_t size)
+{
+	if (ftruncate(writer->Fd, size) < 0)
+	  return -1;
+
+	uint8_t* map = writer->Map ? mremap(writer->Map, writer->MapSize, size, MREMAP_MAYMOVE)
+	                           : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->Fd, 0);
+	if (map == MAP_FAILED)
+	  return -1;
+
+	writer->Map     = map;
+	writer->MapSize = size;
+	writer->Header  = (TraceHeader_t*)map;
+	return 0;
+}
+
+/** Creates a trace, replacing any existing file.
+ *
+ *  \return Zero on success, -1 with errno set otherwise.
+ */
+int TraceWriter_Create(TraceWriter_t* const writer, const char* const path)
+{
+	memset(writer, 0, sizeof(*writer));
+
+	writer->Fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (writer->Fd < 0)
+	  return -1;
+
+	if (Grow(writer, TRACE_GROW_SIZE) < 0)
+	{
+		close(writer->Fd);
+		return -1;
+	}
+
+	TraceHeader_t* header = writer->Header;
+
+	memcpy(header->Magic, TRACE_MAGIC, sizeof(header->Magic));
+	header->Version    = TRACE_VERSION;
+	header->HeaderSize = TRACE_HEADER_SIZE;
+	header->RecordSize = sizeof(TraceRecord_t);
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	header->StartTime = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+	return 0;
+}
+
+/** Tags a new device in the trace.
+ *
+ *  \return Device index for its records, -1 if the device table is full.
+ */
+int TraceWriter_AddDevice(TraceWriter_t* const writer, const char* const serial)
+{
+	TraceHeader_t* header = writer->Header;
+
+	if (header->DeviceCount == TRACE_MAX_DEVICES)
+	  return -1;
+
+	strncpy(header->Serials[header->DeviceCount], serial, TRACE_SERIAL_LENGTH - 1);
+	return header->DeviceCount++;
+}
+
+/** Reserves space for records at the end of the trace. The records become visible to readers once
+ *  filled in and committed with \ref TraceWriter_Commit().
+ *
+ *  \return First reserved record, NULL if the file could not be grown.
+ */
+TraceRecord_t* TraceWriter_Reserve(TraceWriter_t* const writer, const size_t count)
+{
+	size_t end = TRACE_HEADER_SIZE + (writer->Records + count) * sizeof(TraceRecord_t);
+
+	if ((end > writer->MapSize) && (Grow(writer, writer->MapSize + TRACE_GROW_SIZE) < 0))
+	  return NULL;
+
+	TraceRecord_t* records = (TraceRecord_t*)(writer->Map + TRACE_HEADER_SIZE);
+
+	records += writer->Records;
+	writer->Records += count;
+	return records;
+}
+
+/** Publishes all reserved records to readers of the trace. */
+void TraceWriter_Commit(TraceWriter_t* const writer)
+{
+	__atomic_store_n(&writer->Header->RecordCount, writer->Records, __ATOMIC_RELEASE);
+}
+
+/** Commits outstanding records, cuts the file back to its used length and closes it.
+ *
+ *  \return Zero on success, -1 with errno set otherwise.
+ */
+int TraceWriter_Close(TraceWriter_t* const writer)
+{
+	int result = 0;
+
+	TraceWriter_Commit(writer);
+
+	if (msync(writer->Map, writer->MapSize, MS_SYNC) < 0)
+	  result = -1;
+	munmap(writer->Map, writer->MapSize);
+
+	if (ftruncate(writer->Fd, TRACE_HEADER_SIZE + writer->Records * sizeof(TraceRecord_t)) < 0)
+	  result = -1;
+	if (close(writer->Fd) < 0)
+	  result = -1;
+
+	return result;
+}
+
+/** Maps a trace for reading. Records beyond the committed count, or past the end of a truncated
+ *  file, are ignored.
+ *
+ *  \return Zero on success, -1 with errno set otherwise; EINVAL if the file is not a trace.
+ */
+int TraceReader_Open(TraceReader_t* const reader, const char* const path)
+{
+	memset(reader, 0, sizeof(*reader));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	  return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if (st.st_size < TRACE_HEADER_SIZE)
+	{
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	  return -1;
+
+	const TraceHeader_t* header = map;
+
+	if (memcmp(header->Magic, TRACE_MAGIC, sizeof(header->Magic)) || (header->Version != TRACE_VERSION) ||
+	    (header->HeaderSize != TRACE_HEADER_SIZE) || (header->RecordSize != sizeof(TraceRecord_t)))
+	{
+		munmap(map, st.st_size);
+		errno = EINVAL;
+		return -1;
+	}
+
+	uint64_t available = (st.st_size - TRACE_HEADER_SIZE) / sizeof(TraceRecord_t);
+	uint64_t committed = __atomic_load_n(&header->RecordCount, __ATOMIC_ACQUIRE);
+
+	reader->Header  = header;
+	reader->Records = (const TraceRecord_t*)((const uint8_t*)map + TRACE_HEADER_SIZE);
+	reader->Count   = (committed < available) ? committed : available;
+	reader->MapSize = st.st_size;
+	return 0;
+}
+
+/** Returns the index of a device in a trace by its serial number, -1 if it is not tagged. */
+int TraceReader_FindDevice(const TraceReader_t* const reader, const char* const serial)
+{
+	for (uint32_t i = 0; (i < reader->Header->DeviceCount) && (i < TRACE_MAX_DEVICES); i++)
+	{
+		if (!strncmp(reader->Header->Serials[i], serial, TRACE_SERIAL_LENGTH))
+		  return i;
+	}
+
+	return -1;
+}
+
+/** Unmaps a trace opened with \ref TraceReader_Open(). */
+void TraceReader_Close(TraceReader_t* const reader)
+{
+	munmap((void*)reader->Header, reader->MapSize);
+}
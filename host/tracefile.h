@@ -0,0 +1,129 @@
+/** \file
+ *
+ *  Binary capture trace format, written by capture and read back by replay. A trace is a fixed
+ *  4096 byte header followed by an append-only array of fixed size records, one per raw stream
+ *  sample, in host byte order (little endian on every supported host). The writer maps the file
+ *  and appends records in place; the header's record count is only advanced once the records are
+ *  complete, so a trace cut short by a crash still reads back up to its last committed record.
+ */
+
+#ifndef _TRACEFILE_H_
+#define _TRACEFILE_H_
+
+	/* Includes: */
+		#include <stddef.h>
+		#include <stdint.h>
+
+	/* Macros: */
+		/** Magic bytes at the start of every binary trace. */
+		#define TRACE_MAGIC              "TOUCHTRC"
+
+		/** Format version, bumped on incompatible changes. */
+		#define TRACE_VERSION            2
+
+		/** Size in bytes of the trace header, and offset of the first record. */
+		#define TRACE_HEADER_SIZE        4096
+
+		/** Largest number of devices tagged in one trace. */
+		#define TRACE_MAX_DEVICES        16
+
+		/** Size in bytes of a device serial in the header, including its terminating zero. */
+		#define TRACE_SERIAL_LENGTH      64
+
+		/** Size in bytes of a raw stream sample, see raw_stream.h. */
+		#define TRACE_SAMPLE_SIZE        8
+
+	/* Type Defines: */
+		/** Trace file header. */
+		typedef struct
+		{
+			char     Magic[8]; /**< \ref TRACE_MAGIC, not zero terminated. */
+			uint32_t Version; /**< \ref TRACE_VERSION. */
+			uint32_t HeaderSize; /**< \ref TRACE_HEADER_SIZE. */
+			uint32_t RecordSize; /**< sizeof(TraceRecord_t). */
+			uint32_t DeviceCount; /**< Number of valid entries in \ref Serials. */
+			uint64_t StartTime; /**< Wall clock time of the capture start in ns since the epoch. */
+			uint64_t RecordCount; /**< Number of committed records. */
+			uint32_t Overflows[TRACE_MAX_DEVICES]; /**< Samples each device lost to a full queue. */
+			uint32_t Errors[TRACE_MAX_DEVICES]; /**< Failed transfers of each device. */
+			char     Serials[TRACE_MAX_DEVICES][TRACE_SERIAL_LENGTH]; /**< Device serial numbers. */
+		} TraceHeader_t;
+
+		/** Trace record holding one raw stream sample. */
+		typedef struct
+		{
+			uint64_t HostTime; /**< Arrival time of the sample's packet in ns since the capture start. */
+			uint8_t  Device; /**< Index of the device's serial in the header. */
+			uint8_t  Reserved[7];
+			uint8_t  Sample[TRACE_SAMPLE_SIZE]; /**< Packed sample as sent by the firmware. */
+		} TraceRecord_t;
+
+		/** Unpacked raw stream sample. */
+		typedef struct
+		{
+			uint16_t Stamp; /**< Firmware microsecond timestamp of the scan, in steps of 2 us. */
+			uint8_t  Panel; /**< Panel the sample was scanned from. */
+			uint16_t Y;
+			uint16_t X;
+			uint16_t STBY_YD;
+			uint16_t STBY_XR;
+			uint8_t  Flags; /**< RAW_STREAM_FLAG_* mask. */
+		} TraceSample_t;
+
+		/** Trace being written. */
+		typedef struct
+		{
+			int            Fd;
+			uint8_t*       Map;
+			size_t         MapSize;
+			TraceHeader_t* Header;
+			uint64_t       Records; /**< Records appended, committed or not. */
+		} TraceWriter_t;
+
+		/** Trace being read. */
+		typedef struct
+		{
+			const TraceHeader_t* Header;
+			const TraceRecord_t* Records;
+			uint64_t             Count;
+			size_t               MapSize;
+		} TraceReader_t;
+
+	/* Inline Functions: */
+		/** Unpacks a raw stream sample, see RawStream_Push() in the firmware. */
+		static inline void TraceSample_Decode(const uint8_t* const s, TraceSample_t* const sample)
+		{
+			sample->Stamp   = (s[0] & 0xFE) | (s[1] << 8);
+			sample->Panel   = (s[0] & 0x01);
+			sample->Y       = s[2] | ((s[3] & 0x0F) << 8);
+			sample->X       = (s[3] >> 4) | (s[4] << 4);
+			sample->STBY_YD = s[5] | ((s[6] & 0x03) << 8);
+			sample->STBY_XR = (s[6] >> 2) | ((s[7] & 0x0F) << 6);
+			sample->Flags   = (s[7] >> 4);
+		}
+
+		/** Packs a raw stream sample the way the firmware does. */
+		static inline void TraceSample_Encode(const TraceSample_t* const sample, uint8_t* const s)
+		{
+			s[0] = (sample->Stamp & 0xFE) | (sample->Panel & 0x01);
+			s[1] = (sample->Stamp >> 8);
+			s[2] = (sample->Y & 0xFF);
+			s[3] = ((sample->Y >> 8) & 0x0F) | (sample->X << 4);
+			s[4] = (sample->X >> 4);
+			s[5] = (sample->STBY_YD & 0xFF);
+			s[6] = ((sample->STBY_YD >> 8) & 0x03) | (sample->STBY_XR << 2);
+			s[7] = ((sample->STBY_XR >> 6) & 0x0F) | (sample->Flags << 4);
+		}
+
+	/* Function Prototypes: */
+		int TraceWriter_Create(TraceWriter_t* const writer, const char* const path);
+		int TraceWriter_AddDevice(TraceWriter_t* const writer, const char* const serial);
+		TraceRecord_t* TraceWriter_Reserve(TraceWriter_t* const writer, const size_t count);
+		void TraceWriter_Commit(TraceWriter_t* const writer);
+		int TraceWriter_Close(TraceWriter_t* const writer);
+
+		int TraceReader_Open(TraceReader_t* const reader, const char* const path);
+		int TraceReader_FindDevice(const TraceReader_t* const reader, const char* const serial);
+		void TraceReader_Close(TraceReader_t* const reader);
+
+#endif
@@ -0,0 +1,140 @@
+/** \file
+ *
+ *  End-to-end touch latency statistics. Every report sent to the host carries the timestamps of
+ *  its scan and filter output; the report creation time is added here, and the time the host
+ *  collected the report from the IN endpoint once the endpoint's busy banks show it gone. The stage
+ *  latencies are folded into min/avg/max and a histogram, read out over a vendor request.
+ *
+ *  Each panel has its own report in flight. A report created while the previous one of its panel
+ *  is still queued is not measured, so a slow host doesn't shift the timestamps between reports.
+ */
+
+#include "latency.h"
+
+#if TOUCH_LATENCY_STATS
+
+static Latency_Stats_t stats;
+
+/** Measurement states of a panel's report. */
+enum LatencyReportStates_t
+{
+	LATENCY_REPORT_IDLE, /**< No report being measured. */
+	LATENCY_REPORT_CREATED, /**< Created, and queued by the HID driver in the same task run. */
+	LATENCY_REPORT_QUEUED, /**< Waiting in the endpoint for the host. */
+};
+
+/** Latency measurement of a panel's report. */
+typedef struct
+{
+	uint8_t  State; /**< A \ref LatencyReportStates_t value. */
+	uint8_t  Ahead; /**< Busy banks up to and including the report's own. */
+	uint8_t  Busy; /**< Busy banks at the previous poll. */
+	uint16_t Stamps[LATENCY_STAGES - 1]; /**< Scan, filter and report creation timestamps. */
+} latency_report_t;
+
+static latency_report_t reports[TOUCH_PANELS];
+
+/** Clears all latency statistics. */
+void Latency_Reset(void)
+{
+	for (uint8_t i = 0; i < LATENCY_STAGES; i++)
+	{
+		stats.Min[i] = UINT16_MAX;
+		stats.Max[i] = 0;
+		stats.Sum[i] = 0;
+	}
+
+	for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BINS; i++)
+	  stats.Histogram[i] = 0;
+
+	stats.Samples = 0;
+
+	for (uint8_t i = 0; i < TOUCH_PANELS; i++)
+	  reports[i].State = LATENCY_REPORT_IDLE;
+}
+
+/** Records the creation of a HID report that differs from the previous one and will be sent.
+ *
+ *  \param[in] Panel        Panel the report belongs to
+ *  \param[in] ScanStamp    Timestamp of the scan the report's sample came from
+ *  \param[in] FilterStamp  Timestamp of the sample's filter output
+ */
+void Latency_ReportCreated(const uint8_t Panel, const uint16_t ScanStamp, const uint16_t FilterStamp)
+{
+	if (reports[Panel].State != LATENCY_REPORT_IDLE)
+	  return;
+
+	reports[Panel].State     = LATENCY_REPORT_CREATED;
+	reports[Panel].Stamps[0] = ScanStamp;
+	reports[Panel].Stamps[1] = FilterStamp;
+	reports[Panel].Stamps[2] = Timestamp_Now();
+}
+
+static void Account(const uint8_t stage, const uint16_t latency)
+{
+	if (latency < stats.Min[stage])
+	  stats.Min[stage] = latency;
+	if (latency > stats.Max[stage])
+	  stats.Max[stage] = latency;
+
+	stats.Sum[stage] += latency;
+}
+
+/** Follows a panel's report through its IN endpoint, completing the measurement once the host has
+ *  collected it. Called after every HID driver task run with the endpoint's busy bank count. The
+ *  newly created report is the last bank queued, and the host collects banks in order, so every
+ *  drop of the count brings it closer to the front; a report queued behind it in between polls may
+ *  hide a drop, delaying its completion by one poll.
+ *
+ *  \param[in] Panel      Panel whose endpoint was polled
+ *  \param[in] BusyBanks  Banks of the panel's IN endpoint holding reports not yet collected
+ */
+void Latency_EndpointPolled(const uint8_t Panel, const uint8_t BusyBanks)
+{
+	latency_report_t* const report = &reports[Panel];
+
+	if (report->State == LATENCY_REPORT_IDLE)
+	  return;
+
+	if (report->State == LATENCY_REPORT_CREATED)
+	{
+		report->State = LATENCY_REPORT_QUEUED;
+		report->Ahead = BusyBanks;
+	}
+	else if (BusyBanks < report->Busy)
+	{
+		uint8_t collected = (report->Busy - BusyBanks);
+
+		report->Ahead = (collected < report->Ahead) ? (report->Ahead - collected) : 0;
+	}
+
+	report->Busy = BusyBanks;
+	if (report->Ahead)
+	  return;
+
+	uint16_t now = Timestamp_Now();
+
+	report->State = LATENCY_REPORT_IDLE;
+
+	if (stats.Samples == UINT16_MAX)
+	  return;
+
+	Account(LATENCY_STAGE_FILTER, report->Stamps[1] - report->Stamps[0]);
+	Account(LATENCY_STAGE_REPORT, report->Stamps[2] - report->Stamps[1]);
+	Account(LATENCY_STAGE_COLLECT, now - report->Stamps[2]);
+
+	uint16_t total = (now - report->Stamps[0]);
+	uint8_t  bin   = (total >> 10);
+
+	Account(LATENCY_STAGE_TOTAL, total);
+	stats.Histogram[(bin < LATENCY_HISTOGRAM_BINS) ? bin : (LATENCY_HISTOGRAM_BINS - 1)]++;
+	stats.Samples++;
+}
+
+/** Returns the latency statistics gathered since the last reset. */
+const Latency_Stats_t* Latency_GetStats(void)
+{
+	return &stats;
+}
+
+#endif
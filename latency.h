@@ -0,0 +1,64 @@
+/** \file
+ *
+ *  Header file for latency.c.
+ */
+
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+		#include "timestamp.h"
+
+	/* Macros: */
+		/** Number of histogram bins of the total latency, each 1024 us wide. The last bin also
+		 *  counts everything slower.
+		 */
+		#define LATENCY_HISTOGRAM_BINS    8
+
+	/* Enums: */
+		/** Measured latency stages of a touch sample. */
+		enum LatencyStages_t
+		{
+			LATENCY_STAGE_FILTER, /**< Scan complete in the ADC ISR until the filter output. */
+			LATENCY_STAGE_REPORT, /**< Filter output until HID report creation. */
+			LATENCY_STAGE_COLLECT, /**< HID report creation until the host collected it from the endpoint. */
+			LATENCY_STAGE_TOTAL,  /**< Scan complete until the host collected the report. */
+			LATENCY_STAGES,
+		};
+
+	/* Type Defines: */
+		/** Latency statistics as returned by the latency vendor request, little endian. */
+		typedef struct
+		{
+			uint16_t Samples; /**< Number of reports measured. */
+			uint16_t Min[LATENCY_STAGES]; /**< Fastest stage latency in microseconds. */
+			uint16_t Max[LATENCY_STAGES]; /**< Slowest stage latency in microseconds. */
+			uint32_t Sum[LATENCY_STAGES]; /**< Sum of stage latencies in microseconds. */
+			uint16_t Histogram[LATENCY_HISTOGRAM_BINS]; /**< Total latency histogram. */
+		} __attribute__((packed)) Latency_Stats_t;
+
+	/* Function Prototypes: */
+		#if TOUCH_LATENCY_STATS
+		void Latency_Reset(void);
+		void Latency_ReportCreated(const uint8_t Panel, const uint16_t ScanStamp, const uint16_t FilterStamp);
+		void Latency_EndpointPolled(const uint8_t Panel, const uint8_t BusyBanks);
+		const Latency_Stats_t* Latency_GetStats(void);
+		#else
+		static inline void Latency_Reset(void) {}
+		static inline void Latency_ReportCreated(const uint8_t Panel, const uint16_t ScanStamp, const uint16_t FilterStamp)
+		{
+			(void)Panel;
+			(void)ScanStamp;
+			(void)FilterStamp;
+		}
+		static inline void Latency_EndpointPolled(const uint8_t Panel, const uint8_t BusyBanks)
+		{
+			(void)Panel;
+			(void)BusyBanks;
+		}
+		#endif
+
+#endif
@@ -0,0 +1,117 @@
+/** \file
+ *
+ *  Compile time panel profile. The profile header \c Config/Panels/<PANEL_PROFILE>.h gives, for
+ *  each panel n:
+ *
+ *  - \c PANELn_PORT and \c PANELn_DDR: the port the panel is wired to.
+ *  - \c PANELn_PORT_EXCLUSIVE: whether the panel owns the whole port, so the port is written
+ *    without preserving other pins.
+ *  - \c PANELn_PIN_YU, \c _XL, \c _YD and \c _XR: the port pin of each panel electrode.
+ *  - \c PANELn_ADC_XL, \c _YD and \c _XR: the ADC channels of the sensed electrodes, 0 to 13.
+ *  - \c PANELn_ADC_YU, optional: the ADC channel of YU. YU is never sensed, but its digital
+ *    input is disabled like those of the sensed electrodes.
+ *  - \c PANELn_SWAP_XY, \c PANELn_INVERT_X and \c PANELn_INVERT_Y: the mounting orientation.
+ *
+ *  This header turns the profile into the drive pattern of every scan phase and the ADMUX and
+ *  ADCSRB values selecting each channel. Swapped axes drive the other plate in the coordinate
+ *  phases. An inverted axis drives its plate with the opposite polarity. The scan engine only
+ *  stores precomputed values, and no orientation is applied at runtime.
+ */
+
+#ifndef _PANEL_H_
+#define _PANEL_H_
+
+	/* Includes: */
+		#include <avr/io.h>
+
+		#include "Config/AppConfig.h"
+
+		#define PANEL_PROFILE_HEADER_(name)  #name
+		#define PANEL_PROFILE_HEADER(name)   PANEL_PROFILE_HEADER_(Config/Panels/name.h)
+
+		#include PANEL_PROFILE_HEADER(PANEL_PROFILE)
+
+	/* Macros: */
+		/** Port bits of all electrodes of panel \p n. */
+		#define PANEL_MASK(n)           (_BV(PANEL##n##_PIN_YU) | _BV(PANEL##n##_PIN_XL) | \
+		                                 _BV(PANEL##n##_PIN_YD) | _BV(PANEL##n##_PIN_XR))
+
+		/** Drive of panel \p n in the Y coordinate phase: the Y plate, or the X plate when swapped,
+		 *  powered from end to end.
+		 */
+		#define PANEL_Y_PORT(n)         (PANEL##n##_SWAP_XY ? \
+		                                 _BV(PANEL##n##_INVERT_Y ? PANEL##n##_PIN_XL : PANEL##n##_PIN_XR) : \
+		                                 _BV(PANEL##n##_INVERT_Y ? PANEL##n##_PIN_YD : PANEL##n##_PIN_YU))
+		#define PANEL_Y_DDR(n)          (PANEL##n##_SWAP_XY ? \
+		                                 (_BV(PANEL##n##_PIN_XL) | _BV(PANEL##n##_PIN_XR)) : \
+		                                 (_BV(PANEL##n##_PIN_YU) | _BV(PANEL##n##_PIN_YD)))
+		#define PANEL_Y_ADC(n)          (PANEL##n##_SWAP_XY ? PANEL##n##_ADC_YD : PANEL##n##_ADC_XL)
+
+		/** Drive of panel \p n in the X coordinate phase: the X plate, or the Y plate when swapped,
+		 *  powered from end to end.
+		 */
+		#define PANEL_X_PORT(n)         (PANEL##n##_SWAP_XY ? \
+		                                 _BV(PANEL##n##_INVERT_X ? PANEL##n##_PIN_YD : PANEL##n##_PIN_YU) : \
+		                                 _BV(PANEL##n##_INVERT_X ? PANEL##n##_PIN_XL : PANEL##n##_PIN_XR))
+		#define PANEL_X_DDR(n)          (PANEL##n##_SWAP_XY ? \
+		                                 (_BV(PANEL##n##_PIN_YU) | _BV(PANEL##n##_PIN_YD)) : \
+		                                 (_BV(PANEL##n##_PIN_XL) | _BV(PANEL##n##_PIN_XR)))
+		#define PANEL_X_ADC(n)          (PANEL##n##_SWAP_XY ? PANEL##n##_ADC_XL : PANEL##n##_ADC_YD)
+
+		/** Standby drive of panel \p n: YU high and XL low, with the plates connected only through a
+		 *  contact. Mounting does not change it, and it also biases the panel for touch detection.
+		 */
+		#define PANEL_STBY_PORT(n)      _BV(PANEL##n##_PIN_YU)
+		#define PANEL_STBY_DDR(n)       (_BV(PANEL##n##_PIN_YU) | _BV(PANEL##n##_PIN_XL))
+
+		/** Scan phase of panel \p n that reads the X plate position, which the touch resistance
+		 *  estimate needs.
+		 */
+		#define PANEL_PLATE_X_PHASE(n)  (PANEL##n##_SWAP_XY ? ADC_PHASE_Y : ADC_PHASE_X)
+
+		/** Mask that turns the plate X readout of panel \p n back into the distance from XL, for a
+		 *  10-bit readout.
+		 */
+		#define PANEL_PLATE_X_XOR(n)    ((PANEL##n##_SWAP_XY ? PANEL##n##_INVERT_Y : PANEL##n##_INVERT_X) ? 0x3FF : 0)
+
+		/** ADMUX value selecting ADC \p channel against AVcc. */
+		#define PANEL_ADMUX(channel)    (_BV(REFS0) | ((channel) & 0x07))
+
+		/** ADCSRB value selecting ADC \p channel in free running mode, to which the analog
+		 *  comparator adds \c ACME.
+		 */
+		#define PANEL_ADCSRB(channel)   (((channel) & 0x08) ? _BV(MUX5) : 0)
+
+		#if !defined(PANEL0_ADC_YU)
+			#define PANEL0_ADC_YU       PANEL0_ADC_YD
+		#endif
+		#if !defined(PANEL1_ADC_YU)
+			#define PANEL1_ADC_YU       PANEL1_ADC_YD
+		#endif
+
+		/** Digital input disable bits of the analog electrodes of panel \p n, in DIDR0 or DIDR2. */
+		#define PANEL_DIDR_BIT(channel, high) (((!!((channel) & 0x08)) == (high)) ? _BV((channel) & 0x07) : 0)
+		#define PANEL_DIDR(n, high)     (PANEL_DIDR_BIT(PANEL##n##_ADC_YU, high) | PANEL_DIDR_BIT(PANEL##n##_ADC_XL, high) | \
+		                                 PANEL_DIDR_BIT(PANEL##n##_ADC_YD, high) | PANEL_DIDR_BIT(PANEL##n##_ADC_XR, high))
+
+		#if (TOUCH_PANELS > 1)
+			#if !defined(PANEL1_PORT)
+				#error The panel profile has no second panel.
+			#endif
+
+			#if ((PANEL1_ADC_XL > 13) || (PANEL1_ADC_YD > 13) || (PANEL1_ADC_XR > 13))
+				#error The panel profile uses an ADC channel the ATmega32U4 does not have.
+			#endif
+
+			/** Whether any scanned channel needs MUX5, so ADCSRB is written on every phase switch. */
+			#define PANEL_MUX5_USED     (((PANEL0_ADC_XL | PANEL0_ADC_YD | PANEL0_ADC_XR) & 0x08) || \
+			                             ((PANEL1_ADC_XL | PANEL1_ADC_YD | PANEL1_ADC_XR) & 0x08))
+		#else
+			#define PANEL_MUX5_USED     ((PANEL0_ADC_XL | PANEL0_ADC_YD | PANEL0_ADC_XR) & 0x08)
+		#endif
+
+		#if ((PANEL0_ADC_XL > 13) || (PANEL0_ADC_YD > 13) || (PANEL0_ADC_XR > 13))
+			#error The panel profile uses an ADC channel the ATmega32U4 does not have.
+		#endif
+
+#endif
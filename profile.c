@@ -0,0 +1,102 @@
+/** \file
+ *
+ *  CPU utilization profiler. Interrupt handlers and main loop tasks are timed in CPU cycles on
+ *  Timer3, which runs at the CPU clock for the profiler alone, and folded into per-section run
+ *  counts, total and worst-case cycles. Whole main loop iterations may wait for EEPROM writes, so
+ *  they are timed against the microsecond timestamp counter instead. The statistics are read out
+ *  over a vendor request.
+ *
+ *  Timing calls lengthen the ADC ISR noticeably, so the profiler is only built with TOUCH_PROFILE.
+ */
+
+#include "profile.h"
+
+#if TOUCH_PROFILE
+
+static Profile_Stats_t stats;
+static Profile_Stats_t snapshot;
+
+/** Starts the Timer3 cycle counter and clears the profile. */
+void Profile_Init(void)
+{
+	TCCR3A = 0;
+	TCCR3B = PROFILE_CLOCK_SELECT;
+
+	Profile_Reset();
+}
+
+/** Clears the profile. */
+void Profile_Reset(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		for (uint8_t i = 0; i < PROFILE_SECTIONS; i++)
+		{
+			stats.Count[i] = 0;
+			stats.Sum[i]   = 0;
+			stats.Max[i]   = 0;
+		}
+
+		stats.LoopIterations = 0;
+		stats.LoopIdle       = 0;
+		stats.LoopMax        = 0;
+		stats.FrameOverruns  = 0;
+	}
+}
+
+/** Accounts a completed run of a profiled section.
+ *
+ *  \param[in] Section  Section that ran, a \ref ProfileSections_t value
+ *  \param[in] Start    Start timestamp from \ref Profile_Begin()
+ */
+void Profile_End(const uint8_t Section, const uint16_t Start)
+{
+	uint16_t duration = (Profile_Begin() - Start);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		stats.Count[Section]++;
+		stats.Sum[Section] += duration;
+		if (duration > stats.Max[Section])
+		  stats.Max[Section] = duration;
+	}
+}
+
+/** Accounts a completed main loop iteration.
+ *
+ *  \param[in] Busy   Whether the iteration processed a new scan frame
+ *  \param[in] Start  Start timestamp of the iteration from \ref Profile_LoopBegin()
+ */
+void Profile_LoopIteration(const bool Busy, const uint16_t Start)
+{
+	uint16_t duration = (Timestamp_Now() - Start);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		stats.LoopIterations++;
+		if (!Busy)
+		  stats.LoopIdle++;
+		if (duration > stats.LoopMax)
+		  stats.LoopMax = duration;
+	}
+}
+
+/** Accounts a scan frame that replaced an unprocessed one, called from the ADC ISR. */
+void Profile_FrameOverrun(void)
+{
+	if (stats.FrameOverruns != UINT16_MAX)
+	  stats.FrameOverruns++;
+}
+
+/** Returns a consistent copy of the profile gathered since the last reset. */
+const Profile_Stats_t* Profile_GetStats(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		snapshot = stats;
+	}
+
+	return &snapshot;
+}
+
+#endif
@@ -0,0 +1,115 @@
+/** \file
+ *
+ *  Header file for profile.c.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+	/* Includes: */
+		#include <stdbool.h>
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+		#include "timestamp.h"
+
+	/* Enums: */
+		/** Profiled code sections. The ADC sections follow the order of \ref AdcPhase and are
+		 *  attributed to the scan phase active when the ADC ISR was entered.
+		 */
+		enum ProfileSections_t
+		{
+			PROFILE_SECTION_ADC_Y,       /**< ADC ISR during the Y phase. */
+			PROFILE_SECTION_ADC_X,       /**< ADC ISR during the X phase. */
+			PROFILE_SECTION_ADC_STBY_YD, /**< ADC ISR during the standby Y plane phase. */
+			PROFILE_SECTION_ADC_STBY_XR, /**< ADC ISR during the standby X plane phase. */
+			PROFILE_SECTION_SOF,         /**< USB start of frame event, once per millisecond. */
+			PROFILE_SECTION_TOUCH_TASK,  /**< Touch_Task() runs that processed a new frame. */
+			PROFILE_SECTION_HID_TASK,    /**< HID class driver task. */
+			PROFILE_SECTIONS,
+		};
+
+	/* Macros: */
+		/** Timer3 clock select counting CPU cycles, for the section times. */
+		#define PROFILE_CLOCK_SELECT    (1 << CS30)
+
+	/* Type Defines: */
+		/** CPU profile as returned by the profile vendor request, little endian. Section times are
+		 *  in CPU cycles, counted by Timer3 at the CPU clock; a run must stay below 65536 cycles,
+		 *  8.2 ms at 8 MHz, and a section's sum wraps after 2^32 cycles spent in it, about nine
+		 *  minutes at 8 MHz. Main loop times are in microseconds. The start of frame count doubles
+		 *  as the elapsed time in milliseconds, against which the section sums give the CPU
+		 *  utilization.
+		 */
+		typedef struct
+		{
+			uint32_t Count[PROFILE_SECTIONS]; /**< Number of runs of each section. */
+			uint32_t Sum[PROFILE_SECTIONS]; /**< Total cycles spent in each section. */
+			uint16_t Max[PROFILE_SECTIONS]; /**< Cycles of the longest run of each section. */
+			uint32_t LoopIterations; /**< Main loop iterations. */
+			uint32_t LoopIdle; /**< Main loop iterations without a new scan frame. */
+			uint16_t LoopMax; /**< Longest main loop iteration in microseconds, including
+			                   *   interrupts. */
+			uint16_t FrameOverruns; /**< Scan frames completed before the previous one was processed. */
+		} __attribute__((packed)) Profile_Stats_t;
+
+	/* Function Prototypes: */
+		#if TOUCH_PROFILE
+		void Profile_Init(void);
+		void Profile_Reset(void);
+		void Profile_End(const uint8_t Section, const uint16_t Start);
+		void Profile_LoopIteration(const bool Busy, const uint16_t Start);
+		void Profile_FrameOverrun(void);
+		const Profile_Stats_t* Profile_GetStats(void);
+		#else
+		static inline void Profile_Init(void) {}
+		static inline void Profile_Reset(void) {}
+		static inline void Profile_End(const uint8_t Section, const uint16_t Start)
+		{
+			(void)Section;
+			(void)Start;
+		}
+		static inline void Profile_LoopIteration(const bool Busy, const uint16_t Start)
+		{
+			(void)Busy;
+			(void)Start;
+		}
+		static inline void Profile_FrameOverrun(void) {}
+		#endif
+
+	/* Inline Functions: */
+		/** Marks the start of a profiled section.
+		 *
+		 *  \return Start cycle count to pass to \ref Profile_End(), zero when profiling is disabled.
+		 */
+		static inline uint16_t Profile_Begin(void)
+		{
+		#if TOUCH_PROFILE
+			uint16_t now;
+
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				now = TCNT3;
+			}
+
+			return now;
+		#else
+			return 0;
+		#endif
+		}
+
+		/** Marks the start of a main loop iteration.
+		 *
+		 *  \return Start timestamp to pass to \ref Profile_LoopIteration(), zero when profiling is
+		 *          disabled.
+		 */
+		static inline uint16_t Profile_LoopBegin(void)
+		{
+		#if TOUCH_PROFILE
+			return Timestamp_Now();
+		#else
+			return 0;
+		#endif
+		}
+
+#endif
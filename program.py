@@ -1,34 +1,191 @@
 #!/usr/bin/env python3
+"""Flashes a fleet of touch controllers at once. Every device found, or only those with the given
+serial numbers, is asked for the size and CRC of its running image through the update feature
+report, and those not already running the image are reset into their Caterina bootloader through
+the same report. The HID report only enters the bootloader: the image itself goes over Caterina's
+CDC tty. The bootloader ttys are matched back to their devices by USB port as udev announces them,
+the image is written to all of them in parallel by the pipelined AVR109 writer in avr109.py, and
+once each application is back its reported CRC is checked against the image."""
 
-import pyudev, os, sys, time
+import argparse, concurrent.futures, fcntl, os, struct, sys, time
 
-import usb.core
-import usb.util
+import pyudev
 
-# find our device
-dev = usb.core.find(idVendor=0x03eb, idProduct=0x2040)
+from avr109 import Bootloader, TtyPort, crc16, read_hex
 
-# was it found?
-if dev is not None:
-    print('Found DevBoard: resetting')
-    dev = usb.core.find(idVendor=0x03eb, idProduct=0x2040)
-    dev.ctrl_transfer(usb.util.CTRL_TYPE_VENDOR | usb.util.CTRL_RECIPIENT_DEVICE,0x01)
-    time.sleep(5)
+VENDOR_ID = 0x03eb
+PRODUCT_ID = 0x2040
 
-try:
-    filename=sys.argv[1]
-except IndexError:
-    filename="usbdev.hex"
+UPDATE_REPORT_ID = 3
+UPDATE_REPORT = struct.Struct('<IHH')
+MAGIC_BOOT_KEY = 0xDC42ACCA
 
-a=pyudev.Context()
-c=a.list_devices(subsystem='tty',ID_VENDOR="SparkFun_Electronics")
+# Caterina leaves its bootloader for the application after 8 s without programming
+BOOTLOADER_TIMEOUT = 8.0
 
-try:
-    g=list(c)[0]
-except IndexError:
-    print("not found Arduino bootloader")
-    exit(1)
+# Caterina starts the application about half a second after being told to, then it enumerates
+APPLICATION_TIMEOUT = 3.0
 
-tty=g.get('DEVNAME')
+# A freshly started application reports its image only once it has computed the CRC
+IMAGE_INFO_TIMEOUT = 1.0
 
-os.execlp("avrdude","avrdude","-c","avr109","-p","m32u4","-P",tty,"-Uflash:w:"+filename)
+def find_devices(serials):
+    """Returns the hidraw node and serial number of every matching device, by USB port path like
+    1-1.3, which a device keeps across its reset into the bootloader."""
+    devices = {}
+    for device in pyudev.Context().list_devices(subsystem='hidraw'):
+        usb_device = device.find_parent('usb', 'usb_device')
+        if not usb_device or usb_device.get('ID_VENDOR_ID') != '%04x' % VENDOR_ID or \
+                usb_device.get('ID_MODEL_ID') != '%04x' % PRODUCT_ID:
+            continue
+        serial = usb_device.get('ID_SERIAL_SHORT', '?')
+        if serials and serial not in serials:
+            continue
+        devices[usb_device.sys_name] = (serial, device.device_node)
+    return devices
+
+def hidraw_ioctl(number, length):
+    """HIDIOCSFEATURE (0x06) and HIDIOCGFEATURE (0x07) for a buffer of length bytes."""
+    return (3 << 30) | (length << 16) | (ord('H') << 8) | number
+
+def wait_accessible(node, timeout=2.0):
+    """Waits for udev to finish setting up the node's permissions."""
+    deadline = time.monotonic() + timeout
+    while not os.access(node, os.R_OK | os.W_OK) and time.monotonic() < deadline:
+        time.sleep(0.01)
+
+def image_info(node):
+    """Returns the size and CRC of the image a device is running, waiting for the device to finish
+    computing them after a reset."""
+    wait_accessible(node)
+    fd = os.open(node, os.O_RDWR)
+    try:
+        deadline = time.monotonic() + IMAGE_INFO_TIMEOUT
+        while True:
+            buf = bytearray([UPDATE_REPORT_ID]) + bytearray(UPDATE_REPORT.size)
+            fcntl.ioctl(fd, hidraw_ioctl(0x07, len(buf)), buf)
+            _, size, crc = UPDATE_REPORT.unpack_from(buf, 1)
+            if size or time.monotonic() >= deadline:
+                return size, crc
+            time.sleep(0.01)
+    finally:
+        os.close(fd)
+
+def enter_bootloader(node):
+    fd = os.open(node, os.O_RDWR)
+    try:
+        buf = bytearray([UPDATE_REPORT_ID]) + UPDATE_REPORT.pack(MAGIC_BOOT_KEY, 0, 0)
+        fcntl.ioctl(fd, hidraw_ioctl(0x06, len(buf)), buf)
+    except OSError:
+        # The device may drop off the bus before completing the status stage
+        pass
+    finally:
+        os.close(fd)
+
+def flash(node, image):
+    wait_accessible(node)
+    port = TtyPort(node)
+    try:
+        loader = Bootloader(port)
+        loader.program(image)
+        loader.exit()
+    finally:
+        port.close()
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('hexfile', nargs='?', default='usbdev.hex', help='firmware image, usbdev.hex by default')
+    parser.add_argument('-s', '--serial', action='append', default=[],
+                        help='flash only the device with this serial number, may be repeated')
+    parser.add_argument('-f', '--force', action='store_true', help='flash devices already running the image')
+    parser.add_argument('-v', '--verbose', action='store_true', help='print the error of failed devices')
+    args = parser.parse_args()
+
+    if not os.path.exists(args.hexfile):
+        print('%s not found' % args.hexfile)
+        sys.exit(1)
+    with open(args.hexfile) as f:
+        image = read_hex(f.read())
+    expected = (len(image), crc16(image))
+
+    devices = find_devices(set(args.serial))
+    missing = set(args.serial) - {serial for serial, _ in devices.values()}
+    for serial in sorted(missing):
+        print('%s: not found' % serial)
+    if not devices:
+        print('no devices to flash')
+        sys.exit(1)
+
+    results = {}
+    for port, (serial, node) in devices.items():
+        if not args.force and image_info(node) == expected:
+            results[port] = (node, 0.0, 'up to date', None)
+
+    # Listen before resetting, so neither a bootloader nor a returning application can appear
+    # unnoticed
+    monitor = pyudev.Monitor.from_netlink(pyudev.Context())
+    monitor.filter_by('tty')
+    monitor.filter_by('hidraw')
+    monitor.start()
+
+    pending = {port: node for port, (_, node) in devices.items() if port not in results}
+    print('resetting %d device(s) into the bootloader' % len(pending))
+    start = time.monotonic()
+    for node in pending.values():
+        enter_bootloader(node)
+
+    jobs = {}
+    with concurrent.futures.ThreadPoolExecutor(max_workers=max(1, len(pending))) as pool:
+        deadline = start + BOOTLOADER_TIMEOUT
+        while pending and time.monotonic() < deadline:
+            # A job that failed leaves no application to wait for
+            for port in [port for port, (_, job) in jobs.items() if job.done() and job.exception()]:
+                node, job = jobs.pop(port)
+                results[port] = (node, time.monotonic() - start, 'flash failed', job.exception())
+                del pending[port]
+
+            event = monitor.poll(timeout=0.05)
+            if event is None or event.action != 'add' or event.device_node is None:
+                continue
+            usb_device = event.find_parent('usb', 'usb_device')
+            port = usb_device.sys_name if usb_device else None
+            if port not in pending:
+                continue
+
+            if event.subsystem == 'tty' and port not in jobs:
+                print('%s: bootloader on %s' % (devices[port][0], event.device_node))
+                jobs[port] = (event.device_node, pool.submit(flash, event.device_node, image))
+                deadline = max(deadline, time.monotonic() + APPLICATION_TIMEOUT + BOOTLOADER_TIMEOUT)
+            elif event.subsystem == 'hidraw' and port in jobs:
+                node, job = jobs.pop(port)
+                error = job.exception()
+                if error is None:
+                    verified = image_info(event.device_node) == expected
+                    outcome = 'ok' if verified else 'image CRC mismatch'
+                else:
+                    outcome = 'flash failed'
+                results[port] = (node, time.monotonic() - start, outcome, error)
+                del pending[port]
+
+        for port, (node, job) in jobs.items():
+            error = job.exception()
+            results[port] = (node, time.monotonic() - start, 'flash failed' if error else 'application did not return', error)
+
+    failed = 0
+    print('\n%-24s %-10s %-14s %6s  %s' % ('serial', 'port', 'tty', 'time', 'result'))
+    for port, (serial, _) in sorted(devices.items(), key=lambda item: item[1][0]):
+        if port not in results:
+            print('%-24s %-10s %-14s %6s  %s' % (serial, port, '-', '-', 'no bootloader appeared'))
+            failed += 1
+            continue
+        node, seconds, outcome, error = results[port]
+        print('%-24s %-10s %-14s %5.1fs  %s' % (serial, port, node, seconds, outcome))
+        if outcome not in ('ok', 'up to date'):
+            failed += 1
+            if args.verbose and error is not None:
+                print('    %s' % error)
+
+    sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,107 @@
+/** \file
+ *
+ *  Raw scan sample stream for tuning and host side analysis. The ADC ISR packs the readouts of
+ *  every complete scan frame into a ring buffer, which the main loop drains into the bulk IN
+ *  endpoint of the vendor interface, many samples per packet, so the host sees the full scan rate.
+ *  This file holds no USB code, so the host build of the touch pipeline links it unchanged.
+ */
+
+#include "raw_stream.h"
+
+#include <util/atomic.h>
+
+#if TOUCH_RAW_STREAM
+
+uint8_t          RawStream_Queue[RAW_STREAM_QUEUE][RAW_STREAM_SAMPLE_SIZE];
+volatile uint8_t RawStream_Head;
+volatile uint8_t RawStream_Tail;
+volatile uint8_t RawStream_Enabled;
+uint8_t          RawStream_Gap;
+uint16_t         RawStream_Overflows;
+
+/** Milliseconds since the last packet, saturating. */
+static volatile uint8_t flush_timer;
+
+static RawStream_Status_t status;
+
+/** Empties the queue and starts streaming. */
+void RawStream_Start(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		RawStream_Tail    = RawStream_Head;
+		RawStream_Gap     = 0;
+		RawStream_Enabled = 1;
+	}
+}
+
+/** Stops streaming; samples still queued are dropped. */
+void RawStream_Stop(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		RawStream_Enabled = 0;
+		RawStream_Tail    = RawStream_Head;
+	}
+}
+
+/** Advances the packet flush timer, called once per USB frame. */
+void RawStream_MillisecondElapsed(void)
+{
+	if (flush_timer != UINT8_MAX)
+	  flush_timer++;
+}
+
+/** Takes the next packet of queued samples. Packets are only cut once a full packet is queued, or
+ *  \ref RAW_STREAM_FLUSH_MS after the previous one, so a slow scan still streams with bounded delay.
+ *
+ *  \param[out] Packet  Buffer for up to \ref RAW_STREAM_PACKET_SAMPLES packed samples
+ *
+ *  \return Packet length in bytes, zero if no packet is due.
+ */
+uint8_t RawStream_ReadPacket(uint8_t* const Packet)
+{
+	uint8_t tail    = RawStream_Tail;
+	uint8_t pending = (uint8_t)(RawStream_Head - tail);
+
+	if (!pending || ((pending < RAW_STREAM_PACKET_SAMPLES) && (flush_timer < RAW_STREAM_FLUSH_MS)))
+	  return 0;
+
+	if (pending > RAW_STREAM_PACKET_SAMPLES)
+	  pending = RAW_STREAM_PACKET_SAMPLES;
+
+	uint8_t* out = Packet;
+
+	for (uint8_t i = 0; i < pending; i++)
+	{
+		const uint8_t* sample = RawStream_Queue[tail++ & (RAW_STREAM_QUEUE - 1)];
+
+		for (uint8_t b = 0; b < RAW_STREAM_SAMPLE_SIZE; b++)
+		  *(out++) = sample[b];
+	}
+
+	RawStream_Tail = tail;
+	flush_timer    = 0;
+
+	return (pending * RAW_STREAM_SAMPLE_SIZE);
+}
+
+/** Returns the stream status.
+ *
+ *  \param[in] Reset  Whether to clear the overflow counter after reading it
+ */
+const RawStream_Status_t* RawStream_GetStatus(const bool Reset)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		status.Enabled   = RawStream_Enabled;
+		status.Overflows = RawStream_Overflows;
+
+		if (Reset)
+		  RawStream_Overflows = 0;
+	}
+
+	return &status;
+}
+
+#endif
@@ -0,0 +1,134 @@
+/** \file
+ *
+ *  Header file for raw_stream.c.
+ */
+
+#ifndef _RAW_STREAM_H_
+#define _RAW_STREAM_H_
+
+	/* Includes: */
+		#include <stdbool.h>
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+
+	/* Macros: */
+		/** Size in bytes of a packed raw sample, see \ref RawStream_Push(). */
+		#define RAW_STREAM_SAMPLE_SIZE           8
+
+		/** Number of raw samples in a full stream packet. */
+		#define RAW_STREAM_PACKET_SAMPLES        8
+
+		/** Raw sample flag set while the touch pipeline reports a contact. */
+		#define RAW_STREAM_FLAG_TOUCHED          (1 << 0)
+
+		/** Raw sample flag set on the first sample after samples were lost to a full queue. */
+		#define RAW_STREAM_FLAG_GAP              (1 << 1)
+
+		/** Position of the two bit \ref TOUCH_OVERSAMPLE_BITS field in the raw sample flags. */
+		#define RAW_STREAM_FLAG_OVERSAMPLE_SHIFT 2
+
+		/** Raw sample timestamp bit holding the panel the sample was scanned from, as the flags
+		 *  have no bit to spare. Timestamps thus have a resolution of 2 us.
+		 */
+		#define RAW_STREAM_STAMP_PANEL           (1 << 0)
+
+		#if (RAW_STREAM_QUEUE & (RAW_STREAM_QUEUE - 1))
+			#error RAW_STREAM_QUEUE must be a power of two.
+		#endif
+
+	/* Type Defines: */
+		/** Raw stream status as returned by the raw stream vendor request, little endian. */
+		typedef struct
+		{
+			uint8_t  Enabled; /**< Non-zero while the stream is running. */
+			uint16_t Overflows; /**< Samples lost to a full queue since the last reset. */
+		} __attribute__((packed)) RawStream_Status_t;
+
+	/* External Variables: */
+		#if TOUCH_RAW_STREAM
+		extern uint8_t          RawStream_Queue[RAW_STREAM_QUEUE][RAW_STREAM_SAMPLE_SIZE];
+		extern volatile uint8_t RawStream_Head;
+		extern volatile uint8_t RawStream_Tail;
+		extern volatile uint8_t RawStream_Enabled;
+		extern uint8_t          RawStream_Gap;
+		extern uint16_t         RawStream_Overflows;
+		#endif
+
+	/* Function Prototypes: */
+		#if TOUCH_RAW_STREAM
+		void RawStream_Start(void);
+		void RawStream_Stop(void);
+		void RawStream_MillisecondElapsed(void);
+		uint8_t RawStream_ReadPacket(uint8_t* const Packet);
+		const RawStream_Status_t* RawStream_GetStatus(const bool Reset);
+		#else
+		static inline void RawStream_Stop(void) {}
+		static inline void RawStream_MillisecondElapsed(void) {}
+		#endif
+
+	/* Inline Functions: */
+		/** Queues the raw readouts of one panel of a complete scan frame, called from the ADC ISR
+		 *  once per panel. Inlined, so the ISR needs no function call. Samples are packed into 8 bytes,
+		 *  little endian: a 16-bit microsecond timestamp with the panel in \ref RAW_STREAM_STAMP_PANEL,
+		 *  followed by the 48-bit field Y | X << 12 | STBY_YD << 24 | STBY_XR << 34 | Flags << 44,
+		 *  with X/Y in up to 12 and the standby readouts in 10 bits.
+		 *
+		 *  \param[in] Y      Y readout
+		 *  \param[in] X      X readout
+		 *  \param[in] YD     Standby Y plane readout
+		 *  \param[in] XR     Standby X plane readout
+		 *  \param[in] Stamp  Completion timestamp of the scan
+		 *  \param[in] Panel  Panel the readouts were scanned from
+		 *  \param[in] Flags  \c RAW_STREAM_FLAG_* mask of the scan
+		 */
+		static inline void RawStream_Push(const uint16_t Y, const uint16_t X, const uint16_t YD,
+		                                  const uint16_t XR, uint16_t Stamp, const uint8_t Panel,
+		                                  uint8_t Flags)
+		{
+		#if TOUCH_RAW_STREAM
+			if (!RawStream_Enabled)
+			  return;
+
+			uint8_t head = RawStream_Head;
+
+			if ((uint8_t)(head - RawStream_Tail) >= RAW_STREAM_QUEUE)
+			{
+				if (RawStream_Overflows != UINT16_MAX)
+				  RawStream_Overflows++;
+				RawStream_Gap = 1;
+				return;
+			}
+
+			if (RawStream_Gap)
+			{
+				Flags |= RAW_STREAM_FLAG_GAP;
+				RawStream_Gap = 0;
+			}
+
+			uint8_t* sample = RawStream_Queue[head & (RAW_STREAM_QUEUE - 1)];
+
+			Stamp = (Stamp & ~RAW_STREAM_STAMP_PANEL) | Panel;
+
+			sample[0] = (Stamp & 0xFF);
+			sample[1] = (Stamp >> 8);
+			sample[2] = (Y & 0xFF);
+			sample[3] = ((Y >> 8) & 0x0F) | (X << 4);
+			sample[4] = (X >> 4);
+			sample[5] = (YD & 0xFF);
+			sample[6] = ((YD >> 8) & 0x03) | (XR << 2);
+			sample[7] = ((XR >> 6) & 0x0F) | (Flags << 4);
+
+			RawStream_Head = head + 1;
+		#else
+			(void)Y;
+			(void)X;
+			(void)YD;
+			(void)XR;
+			(void)Stamp;
+			(void)Panel;
+			(void)Flags;
+		#endif
+		}
+
+#endif
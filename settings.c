@@ -0,0 +1,190 @@
+/** \file
+ *
+ *  Runtime tunable touch pipeline settings. The host requests new settings through a feature
+ *  report; they take effect at the next scan frame boundary, so a frame is never processed with a
+ *  mix of old and new values, and are saved to a wear-leveled EEPROM ring in the background.
+ *
+ *  Every save goes into the slot after the newest record, with the next sequence number, so each
+ *  slot is only erased once every \ref TOUCH_SETTINGS_SLOTS saves. On startup the valid record with
+ *  the highest sequence number wins; a save torn by a reset fails its CRC and leaves the previous
+ *  record in charge.
+ */
+
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#include "settings.h"
+#include "touch.h"
+
+/** Layout version of the stored settings, bumped on incompatible changes. */
+#define SETTINGS_VERSION    2
+
+/** EEPROM settings record, one per ring slot. */
+typedef struct
+{
+	uint8_t    Version;
+	uint8_t    Sequence; /**< Save counter, wrapping; the newest valid record is in use. */
+	Settings_t Settings;
+	uint8_t    CRC; /**< CRC-8 of the preceding bytes. */
+} __attribute__((packed)) SettingsRecord_t;
+
+static SettingsRecord_t EEMEM settings_ring[TOUCH_SETTINGS_SLOTS];
+
+static const Settings_t settings_defaults =
+	{
+		.ZPress           = TOUCH_Z_PRESS,
+		.ZRelease         = TOUCH_Z_RELEASE,
+		.ZConfident       = TOUCH_Z_CONFIDENT,
+		.RailMargin       = TOUCH_RAIL_MARGIN,
+		.SettleSpread     = TOUCH_SETTLE_SPREAD,
+		.Deadband         = TOUCH_DEADBAND,
+		.ZDeadband        = TOUCH_Z_DEADBAND,
+		.FilterMaxShift   = TOUCH_FILTER_MAX_SHIFT,
+		.FilterStillDelta = TOUCH_FILTER_STILL_DELTA,
+		.AdcPrescalerBits = TOUCH_ADC_PRESCALER_BITS,
+		.Settle           =
+			{
+				[ADC_PHASE_Y]       = TOUCH_SETTLE_XY,
+				[ADC_PHASE_X]       = TOUCH_SETTLE_XY,
+				[ADC_PHASE_STBY_YD] = TOUCH_SETTLE_STBY,
+				[ADC_PHASE_STBY_XR] = TOUCH_SETTLE_STBY,
+			},
+	};
+
+Settings_t Settings;
+
+/** Newest accepted settings, waiting for the next frame boundary while \ref apply_pending is set. */
+static Settings_t requested;
+static bool apply_pending;
+
+/** Record being saved, or last saved, into ring slot \ref save_slot. */
+static SettingsRecord_t save_record;
+static uint8_t save_slot;
+
+/** Bytes of \ref save_record written so far, the record size once it is completely saved. */
+static uint8_t save_offset = sizeof(SettingsRecord_t);
+
+/** Computes the CRC of a settings record, excluding its CRC field. */
+static uint8_t RecordCRC(const SettingsRecord_t* const record)
+{
+	const uint8_t* data = (const uint8_t*)record;
+	uint8_t crc = 0;
+
+	for (uint8_t i = 0; i < offsetof(SettingsRecord_t, CRC); i++)
+	  crc = _crc8_ccitt_update(crc, data[i]);
+
+	return crc;
+}
+
+/** Checks settings against the ranges the touch pipeline copes with. */
+static bool Acceptable(const Settings_t* const settings)
+{
+	for (uint8_t phase = 0; phase < ADC_PHASE_COUNT; phase++)
+	{
+		if (!(settings->Settle[phase]) || (settings->Settle[phase] > TOUCH_SETTLE_MAX))
+		  return false;
+	}
+
+	return (settings->ZPress <= settings->ZRelease) &&
+	       (settings->FilterMaxShift <= 7) &&
+	       (settings->AdcPrescalerBits >= 1) && (settings->AdcPrescalerBits <= 7);
+}
+
+/** Loads the newest valid settings record from the EEPROM ring, falling back to the configured
+ *  defaults if there is none.
+ */
+void Settings_Init(void)
+{
+	SettingsRecord_t record;
+	bool found = false;
+
+	Settings = settings_defaults;
+	save_slot = (TOUCH_SETTINGS_SLOTS - 1);
+	save_record.Sequence = 0xFF;
+
+	for (uint8_t slot = 0; slot < TOUCH_SETTINGS_SLOTS; slot++)
+	{
+		eeprom_read_block(&record, &settings_ring[slot], sizeof(record));
+
+		if ((record.Version != SETTINGS_VERSION) || (record.CRC != RecordCRC(&record)) ||
+		    !(Acceptable(&record.Settings)))
+		{
+			continue;
+		}
+
+		if (!found || ((int8_t)(record.Sequence - save_record.Sequence) > 0))
+		{
+			Settings = record.Settings;
+			save_slot = slot;
+			save_record.Sequence = record.Sequence;
+			found = true;
+		}
+	}
+
+	requested = Settings;
+}
+
+/** Accepts new settings, to be applied at the next scan frame boundary and saved. A request while
+ *  the previous one is still being saved restarts that save with the new settings.
+ *
+ *  \param[in] NewSettings  Requested settings
+ *
+ *  \return Boolean \c true if the settings were accepted, \c false if a value is out of range.
+ */
+bool Settings_Request(const Settings_t* const NewSettings)
+{
+	if (!(Acceptable(NewSettings)))
+	  return false;
+
+	requested = *NewSettings;
+	apply_pending = true;
+
+	if (save_offset == sizeof(SettingsRecord_t))
+	{
+		save_slot = ((save_slot + 1) % TOUCH_SETTINGS_SLOTS);
+		save_record.Sequence++;
+	}
+
+	save_record.Version  = SETTINGS_VERSION;
+	save_record.Settings = *NewSettings;
+	save_record.CRC      = RecordCRC(&save_record);
+	save_offset = 0;
+
+	return true;
+}
+
+/** Returns the newest accepted settings, which may not be in use until the next frame boundary. */
+const Settings_t* Settings_GetRequested(void)
+{
+	return &requested;
+}
+
+/** Switches to the newest accepted settings, called by the touch pipeline between scan frames.
+ *  The copy is made with interrupts masked, as the ADC ISR latches its own settings from
+ *  \ref Settings at its next frame boundary.
+ */
+void Settings_Apply(void)
+{
+	if (!apply_pending)
+	  return;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		Settings = requested;
+	}
+	apply_pending = false;
+}
+
+/** Saves the next byte of a pending settings record once the EEPROM is ready, so a save never
+ *  blocks the main loop for the several milliseconds every EEPROM byte write takes.
+ */
+void Settings_Task(void)
+{
+	if ((save_offset == sizeof(SettingsRecord_t)) || !(eeprom_is_ready()))
+	  return;
+
+	eeprom_update_byte((uint8_t*)&settings_ring[save_slot] + save_offset, ((const uint8_t*)&save_record)[save_offset]);
+	save_offset++;
+}
@@ -0,0 +1,47 @@
+/** \file
+ *
+ *  Header file for settings.c.
+ */
+
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+	/* Includes: */
+		#include <stdbool.h>
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+
+	/* Type Defines: */
+		/** Runtime tunable parameters of the touch pipeline, little endian, as carried by the settings
+		 *  feature report. Each defaults to the configuration token of the same name.
+		 */
+		typedef struct
+		{
+			uint16_t ZPress; /**< \ref TOUCH_Z_PRESS */
+			uint16_t ZRelease; /**< \ref TOUCH_Z_RELEASE, at least \c ZPress. */
+			uint16_t ZConfident; /**< \ref TOUCH_Z_CONFIDENT */
+			uint8_t  RailMargin; /**< \ref TOUCH_RAIL_MARGIN */
+			uint8_t  SettleSpread; /**< \ref TOUCH_SETTLE_SPREAD */
+			uint8_t  Deadband; /**< \ref TOUCH_DEADBAND */
+			uint8_t  ZDeadband; /**< \ref TOUCH_Z_DEADBAND */
+			uint8_t  FilterMaxShift; /**< \ref TOUCH_FILTER_MAX_SHIFT, at most 7. */
+			uint8_t  FilterStillDelta; /**< \ref TOUCH_FILTER_STILL_DELTA */
+			uint8_t  AdcPrescalerBits; /**< ADC clock prescaler as a power of two, 1 to 7,
+			                            *   \ref TOUCH_ADC_PRESCALER_BITS. */
+			uint8_t  Settle[4]; /**< Conversions discarded after switching to each scan phase, in
+			                     *   \ref AdcPhase order, 1 to \ref TOUCH_SETTLE_MAX. */
+		} __attribute__((packed)) Settings_t;
+
+	/* External Variables: */
+		/** Settings in use by the touch pipeline, only changed by \ref Settings_Apply(). */
+		extern Settings_t Settings;
+
+	/* Function Prototypes: */
+		void Settings_Init(void);
+		bool Settings_Request(const Settings_t* const NewSettings);
+		const Settings_t* Settings_GetRequested(void);
+		void Settings_Apply(void);
+		void Settings_Task(void);
+
+#endif
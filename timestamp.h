@@ -0,0 +1,51 @@
+/** \file
+ *
+ *  Microsecond timestamps from the free running Timer1, shared by the touch pipeline and its
+ *  instrumentation. The 16-bit counter wraps every 65.5 ms, so only differences of timestamps
+ *  less than that apart are meaningful.
+ */
+
+#ifndef _TIMESTAMP_H_
+#define _TIMESTAMP_H_
+
+	/* Includes: */
+		#include <avr/io.h>
+		#include <util/atomic.h>
+		#include <stdint.h>
+
+	/* Macros: */
+		#if (F_CPU == 8000000UL)
+			/** Timer1 clock select giving one tick per microsecond. */
+			#define TIMESTAMP_CLOCK_SELECT    (1 << CS11)
+		#elif (F_CPU == 1000000UL)
+			#define TIMESTAMP_CLOCK_SELECT    (1 << CS10)
+		#else
+			#error Timestamps need a Timer1 prescaler giving 1 MHz for this F_CPU.
+		#endif
+
+	/* Inline Functions: */
+		/** Starts Timer1 as the free running microsecond timestamp counter. */
+		static inline void Timestamp_Init(void)
+		{
+			TCCR1A = 0;
+			TCCR1B = TIMESTAMP_CLOCK_SELECT;
+		}
+
+		/** Returns the current timestamp. Safe to call from interrupt and main loop context alike,
+		 *  as the 16-bit read shares the timer's TEMP register with any interrupt reading it.
+		 *
+		 *  \return Current time in microseconds.
+		 */
+		static inline uint16_t Timestamp_Now(void)
+		{
+			uint16_t now;
+
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+			{
+				now = TCNT1;
+			}
+
+			return now;
+		}
+
+#endif
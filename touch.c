@@ -0,0 +1,1073 @@
+/** \file
+ *
+ *  Touch panel scan engine and coordinate pipeline. This file only touches the ADC and panel
+ *  port registers, so it builds unchanged against the mocked register layer in host/.
+ */
+
+#include "touch.h"
+
+/** Panel drive pattern and precomputed multiplexer setting of a single scan phase. Its settle time,
+ *  being tunable and measurable, is in \ref Settings_t.
+ */
+typedef struct
+{
+	uint8_t Port; /**< Panel port value driving the panel during the phase. */
+	uint8_t Ddr; /**< Panel data direction value driving the panel during the phase. */
+	uint8_t Admux; /**< ADMUX value selecting the channel sensed during the phase. */
+	uint8_t Adcsrb; /**< ADCSRB value selecting the channel sensed during the phase. */
+	uint8_t Count; /**< Number of conversions accumulated into the readout. */
+	uint8_t Shift; /**< Decimation right shift applied to the accumulated conversions. */
+} AdcPhaseConfig_t;
+
+/** Conversions accumulated per oversampled X/Y readout. */
+#define ADC_OVERSAMPLE_COUNT (1 << (2 * TOUCH_OVERSAMPLE_BITS))
+
+/** Scan phases of panel \p n, generated from the panel profile, see panel.h. */
+#define ADC_PHASES(n) \
+	{ \
+		[ADC_PHASE_Y]       = {.Port = PANEL_Y_PORT(n), .Ddr = PANEL_Y_DDR(n), \
+		                       .Admux = PANEL_ADMUX(PANEL_Y_ADC(n)), .Adcsrb = PANEL_ADCSRB(PANEL_Y_ADC(n)), \
+		                       .Count = ADC_OVERSAMPLE_COUNT, .Shift = TOUCH_OVERSAMPLE_BITS}, \
+		[ADC_PHASE_X]       = {.Port = PANEL_X_PORT(n), .Ddr = PANEL_X_DDR(n), \
+		                       .Admux = PANEL_ADMUX(PANEL_X_ADC(n)), .Adcsrb = PANEL_ADCSRB(PANEL_X_ADC(n)), \
+		                       .Count = ADC_OVERSAMPLE_COUNT, .Shift = TOUCH_OVERSAMPLE_BITS}, \
+		[ADC_PHASE_STBY_YD] = {.Port = PANEL_STBY_PORT(n), .Ddr = PANEL_STBY_DDR(n), \
+		                       .Admux = PANEL_ADMUX(PANEL##n##_ADC_YD), .Adcsrb = PANEL_ADCSRB(PANEL##n##_ADC_YD), \
+		                       .Count = 1, .Shift = 0}, \
+		[ADC_PHASE_STBY_XR] = {.Port = PANEL_STBY_PORT(n), .Ddr = PANEL_STBY_DDR(n), \
+		                       .Admux = PANEL_ADMUX(PANEL##n##_ADC_XR), .Adcsrb = PANEL_ADCSRB(PANEL##n##_ADC_XR), \
+		                       .Count = 1, .Shift = 0}, \
+	}
+
+static const AdcPhaseConfig_t adc_phases[TOUCH_PANELS][ADC_PHASE_COUNT] =
+	{
+		ADC_PHASES(0),
+#if (TOUCH_PANELS > 1)
+		ADC_PHASES(1),
+#endif
+	};
+
+/** Raw readouts of one complete Y/X/standby scan of every panel, indexed by panel and
+ *  \ref AdcPhase. X/Y hold \ref TOUCH_RESOLUTION_BITS bits, the standby readouts 10 bits.
+ */
+typedef struct
+{
+	uint16_t Raw[TOUCH_PANELS][ADC_PHASE_COUNT];
+#if TOUCH_OVERSAMPLE_BITS
+	uint16_t Spread[TOUCH_PANELS]; /**< Largest conversion spread within an oversampled readout. */
+#endif
+	uint16_t ScanTime; /**< Completion time of the scan in 100 us units. */
+	uint16_t Stamp; /**< Completion timestamp of the scan. */
+} touch_frame_t;
+
+/** Double buffered scan results: the ADC ISR fills one frame while the other holds the newest
+ *  complete scan for \ref Touch_Task.
+ */
+static touch_frame_t touch_internals[2];
+static uint8_t adc_write_frame;
+static volatile uint8_t adc_frame_ready;
+
+/** Scan phase the ADC is currently converting, a \ref AdcPhase value. */
+static uint8_t adc_phase;
+
+#if (TOUCH_PANELS > 1)
+/** Panel the ADC is currently converting. Scan steps run phase by phase, every panel in turn, and
+ *  each panel switches to the drive pattern of its next phase as soon as it is converted, so it
+ *  settles while the other panels convert.
+ */
+static uint8_t adc_panel;
+
+/** Conversions completed, wrapping, and their count when each panel's drive pattern last changed,
+ *  from which \ref StartStep() tells how long a panel has settled already.
+ */
+static uint8_t adc_conversions;
+static uint8_t drive_stamp[TOUCH_PANELS];
+
+/** Panel whose Y plane the analog comparator watches while the scan engine is idle. */
+static uint8_t detect_panel;
+#else
+#define adc_panel 0
+#endif
+
+/** Conversions still to discard before the current phase has settled. */
+static uint8_t adc_discard;
+
+_Static_assert(sizeof(Settings.Settle) == ADC_PHASE_COUNT, "Settings_t needs a settle time per scan phase");
+
+/** Touch detect bias of panel \p n: the X plane held low through XL and the Y plane pulled up by
+ *  the internal pull-up of YU. A contact pulls the Y plane, sensed on YD by the analog comparator,
+ *  below the bandgap reference.
+ */
+#define DETECT_PORT(n)   _BV(PANEL##n##_PIN_YU)
+#define DETECT_DDR(n)    _BV(PANEL##n##_PIN_XL)
+#define DETECT_ADMUX(n)  PANEL_ADMUX(PANEL##n##_ADC_YD)
+#define DETECT_ADCSRB(n) (_BV(ACME) | PANEL_ADCSRB(PANEL##n##_ADC_YD))
+
+/** Set by \ref Touch_Task or \ref Touch_Suspend() to stop the scan engine at the next frame
+ *  boundary.
+ */
+static volatile uint8_t adc_idle_request;
+
+/** Set while the scan engine is stopped, waiting for the analog comparator. */
+static volatile uint8_t adc_idle;
+
+/** Set while the bus is suspended, when only \ref Touch_Resume() restarts the scan engine. */
+static volatile uint8_t adc_suspended;
+
+#if TOUCH_IDLE_DETECT
+/** Scan frames without contact after which the scan engine idles. */
+#define IDLE_FRAMES ((uint16_t)(((uint32_t)TOUCH_IDLE_MS * 1000 + TOUCH_SCAN_PERIOD_US - 1) / TOUCH_SCAN_PERIOD_US))
+
+/** Milliseconds since the scan engine went idle or last polled. */
+static uint8_t idle_poll_ms;
+#endif
+
+#if TOUCH_SETTLE_MEASURE
+/** Settle curve measurement, recorded by the ADC ISR in place of a scan frame. */
+static Touch_SettleMeasurement_t settle_measurement;
+
+/** Phase whose settle curve the ADC ISR is recording, \ref ADC_PHASE_COUNT while scanning. */
+static uint8_t settle_phase = ADC_PHASE_COUNT;
+static uint8_t settle_index;
+static volatile uint8_t settle_requested;
+static volatile uint8_t settle_recorded;
+#endif
+
+/** ADC prescaler the scan engine is running with, as a power of two. */
+static uint8_t adc_prescaler_bits;
+
+/** Settle conversions of every scan phase the scan engine is running with. */
+static uint8_t adc_settle[ADC_PHASE_COUNT];
+
+/** Scan time clock in 100 us units, advanced from the USB start of frame. */
+static uint16_t scan_clock;
+
+typedef struct {
+	uint16_t Y;
+	uint16_t X;
+	uint16_t Z;
+	uint16_t ScanTime;
+	uint16_t ScanStamp;
+	uint16_t FilterStamp;
+	uint8_t pressed;
+} touch_vals_t;
+
+#if (TOUCH_REPORT_QUEUE & (TOUCH_REPORT_QUEUE - 1))
+	#error TOUCH_REPORT_QUEUE must be a power of two.
+#endif
+
+/** Processing and reporting state of one panel. */
+typedef struct
+{
+	touch_vals_t Vals; /**< Values of the newest processed frame. */
+	uint8_t FullUpdate; /**< Set while a contact is being tracked. */
+#if TOUCH_IDLE_DETECT
+	uint16_t IdleFrames; /**< Frames without any contact, up to \ref IDLE_FRAMES. */
+#endif
+#if TOUCH_FILTER
+	TouchFilterAxis_t FilterX;
+	TouchFilterAxis_t FilterY;
+#endif
+#if TOUCH_PREDICT
+	TouchPredictAxis_t PredictX;
+	TouchPredictAxis_t PredictY;
+#endif
+#if TOUCH_CALIBRATION
+	/** Filtered coordinates of the newest pressed frame before calibration, for calibrating. */
+	uint16_t UncalibratedX;
+	uint16_t UncalibratedY;
+#endif
+	/** Processed samples waiting for the HID report, oldest at \ref QueueTail. Both ends are only
+	 *  touched from the main loop.
+	 */
+	touch_vals_t Queue[TOUCH_REPORT_QUEUE];
+	uint8_t QueueHead;
+	uint8_t QueueTail;
+	touch_vals_t Reported; /**< Newest sample drained from the queue. */
+	USB_TouchReport_Data_t LastReport;
+#if TOUCH_REPORT_BATCH
+	uint16_t BatchStamp; /**< Scan stamp of the newest batched sample. */
+#endif
+} touch_panel_t;
+
+static touch_panel_t touch_panels[TOUCH_PANELS] =
+	{
+		[0 ... (TOUCH_PANELS - 1)] = {.LastReport = {.ContactCount = 1}},
+	};
+
+/** Reciprocals 2^25 / m of the bucket centres of a normalized 10-bit divisor m in [512, 1023],
+ *  eight values wide, used by \ref TouchResistance() in place of a division.
+ */
+static const uint16_t PROGMEM z_reciprocals[64] =
+	{
+		65028, 64035, 63072, 62138, 61231, 60350, 59494, 58662,
+		57852, 57065, 56299, 55554, 54828, 54120, 53431, 52759,
+		52103, 51464, 50840, 50231, 49637, 49056, 48489, 47935,
+		47393, 46864, 46346, 45839, 45344, 44859, 44384, 43919,
+		43464, 43019, 42582, 42154, 41734, 41323, 40920, 40525,
+		40137, 39756, 39383, 39017, 38657, 38304, 37958, 37617,
+		37283, 36954, 36631, 36314, 36003, 35696, 35395, 35099,
+		34808, 34521, 34239, 33962, 33689, 33421, 33157, 32897,
+	};
+
+#if TOUCH_PREDICT
+/** Prediction horizon in scan frames, with \ref TOUCH_PREDICT_FRAC_BITS fractional bits. */
+#define TOUCH_PREDICT_HORIZON_FRAMES \
+	((uint16_t)(((uint32_t)TOUCH_PREDICT_HORIZON_US << TOUCH_PREDICT_FRAC_BITS) / TOUCH_SCAN_PERIOD_US))
+#endif
+
+/** Drives the pins of panel \p n, leaving the other pins of its port alone unless the panel has the
+ *  port to itself.
+ */
+#define DRIVE_PANEL(n, port, ddr) \
+	do \
+	{ \
+		if (PANEL##n##_PORT_EXCLUSIVE) \
+		{ \
+			PANEL##n##_PORT = (port); \
+			PANEL##n##_DDR = (ddr); \
+		} \
+		else \
+		{ \
+			PANEL##n##_PORT = (PANEL##n##_PORT & ~PANEL_MASK(n)) | (port); \
+			PANEL##n##_DDR = (PANEL##n##_DDR & ~PANEL_MASK(n)) | (ddr); \
+		} \
+	} while (0)
+
+/** Drives the pins of a panel. */
+static void Drive(const uint8_t panel, const uint8_t port, const uint8_t ddr)
+{
+#if (TOUCH_PANELS > 1)
+	if (panel)
+	{
+		DRIVE_PANEL(1, port, ddr);
+		return;
+	}
+#else
+	(void)panel;
+#endif
+	DRIVE_PANEL(0, port, ddr);
+}
+
+/** Selects the channel sensed in a scan phase. ADCSRB only needs writing when some channel is
+ *  selected through MUX5.
+ */
+static void Sense(const AdcPhaseConfig_t* const config)
+{
+	ADMUX = config->Admux;
+#if PANEL_MUX5_USED
+	ADCSRB = config->Adcsrb;
+#endif
+}
+
+static void StartPhase(const uint8_t panel, const uint8_t phase)
+{
+	Drive(panel, adc_phases[panel][phase].Port, adc_phases[panel][phase].Ddr);
+	Sense(&adc_phases[panel][phase]);
+}
+
+#if (TOUCH_PANELS > 1)
+/** Moves the ADC on to the scan step of \ref adc_panel and \ref adc_phase, whose drive pattern is
+ *  applied already. Conversions since the pattern changed count towards the phase's settle time,
+ *  but the conversion already running on the previous channel is always discarded.
+ */
+static void StartStep(void)
+{
+	uint8_t settle  = adc_settle[adc_phase];
+	uint8_t elapsed = adc_conversions - drive_stamp[adc_panel];
+
+	Sense(&adc_phases[adc_panel][adc_phase]);
+	adc_discard = (settle > (elapsed + 1)) ? (settle - elapsed) : 1;
+}
+#endif
+
+/** Latches the settings the scan engine uses into its own copies. Done at frame boundaries only,
+ *  so every frame is scanned with one set of settings whenever the main loop applies new ones.
+ */
+static void LatchSettings(void)
+{
+	for (uint8_t phase = 0; phase < ADC_PHASE_COUNT; phase++)
+		adc_settle[phase] = Settings.Settle[phase];
+	adc_prescaler_bits = Settings.AdcPrescalerBits;
+}
+
+/** Starts free running conversions with the first scan phase. */
+static void StartScanning(void)
+{
+	LatchSettings();
+
+#if (TOUCH_PANELS > 1)
+	for (uint8_t panel = 1; panel < TOUCH_PANELS; panel++)
+	{
+		StartPhase(panel, 0);
+		drive_stamp[panel] = adc_conversions;
+	}
+	drive_stamp[0] = adc_conversions;
+	adc_panel = 0;
+#endif
+	StartPhase(0, 0);
+	adc_discard = adc_settle[0];
+	//free running mode
+	ADCSRB = adc_phases[0][0].Adcsrb;
+	//set prescaller, enable ADC with its interrupt and start auto triggered conversions
+	ADCSRA = adc_prescaler_bits|(1<<ADEN)|(1<<ADATE)|(1<<ADIE)|(1<<ADSC);
+}
+
+/** Configures the ADC for free running conversions and starts the scan engine. */
+void Touch_Init(void)
+{
+	Timestamp_Init();
+
+#if (TOUCH_PANELS > 1)
+	DIDR0 = PANEL_DIDR(0, 0) | PANEL_DIDR(1, 0);
+	DIDR2 = PANEL_DIDR(0, 1) | PANEL_DIDR(1, 1);
+#else
+	DIDR0 = PANEL_DIDR(0, 0);
+	DIDR2 = PANEL_DIDR(0, 1);
+#endif
+	StartScanning();
+}
+
+/** Stops the scan engine at a frame boundary and biases the panels for the analog comparator, which
+ *  takes the ADC multiplexer while the ADC is disabled. Its interrupt only wakes the scan engine
+ *  while the bus is up; during suspend the main loop polls it. With several panels it watches one
+ *  at a time, see \ref NextDetectPanel().
+ */
+static void StartDetect(void)
+{
+	ADCSRA = _BV(ADIF);
+	Drive(0, DETECT_PORT(0), DETECT_DDR(0));
+#if (TOUCH_PANELS > 1)
+	Drive(1, DETECT_PORT(1), DETECT_DDR(1));
+	detect_panel = 0;
+#endif
+	ADMUX = DETECT_ADMUX(0);
+	ADCSRB = DETECT_ADCSRB(0);
+	ACSR = _BV(ACBG) | _BV(ACI) | (adc_suspended ? 0 : _BV(ACIE)) | _BV(ACIS1) | _BV(ACIS0);
+
+	adc_idle_request = 0;
+	adc_idle = 1;
+#if TOUCH_IDLE_DETECT
+	idle_poll_ms = 0;
+#endif
+}
+
+#if (TOUCH_PANELS > 1)
+/** Moves the analog comparator on to the Y plane of the other panel. The multiplexer switch may
+ *  glitch the comparator output, so its interrupt is held off and the flag cleared meanwhile.
+ */
+static void NextDetectPanel(void)
+{
+	uint8_t acsr = ACSR;
+
+	ACSR = acsr & ~(_BV(ACIE) | _BV(ACI));
+	detect_panel ^= 1;
+	ADMUX = detect_panel ? DETECT_ADMUX(1) : DETECT_ADMUX(0);
+	ADCSRB = detect_panel ? DETECT_ADCSRB(1) : DETECT_ADCSRB(0);
+	ACSR = acsr | _BV(ACI);
+}
+#endif
+
+/** Switches the analog comparator off and bursts back into full rate scanning. */
+static void Wake(void)
+{
+	ACSR = _BV(ACD) | _BV(ACI);
+	adc_idle = 0;
+	StartScanning();
+}
+
+#if TOUCH_IDLE_DETECT
+/** Analog comparator ISR, firing when a contact pulls the biased Y plane below the bandgap. */
+ISR(ANALOG_COMP_vect)
+{
+	if (adc_idle)
+		Wake();
+}
+#endif
+
+/** Stops the scan engine for a bus suspend, waiting for the end of the frame in progress. With
+ *  \ref POWER_REMOTE_WAKEUP the panel is left biased for the analog comparator, which draws no
+ *  current until it is touched, otherwise it is left floating.
+ */
+void Touch_Suspend(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		adc_suspended = 1;
+
+		/* An idle scan engine is rearmed without the comparator interrupt */
+		if (adc_idle)
+			StartDetect();
+		else
+			adc_idle_request = 1;
+	}
+
+	while (!adc_idle);
+
+#if !POWER_REMOTE_WAKEUP
+	ACSR = _BV(ACD) | _BV(ACI);
+	Drive(0, 0, 0);
+#if (TOUCH_PANELS > 1)
+	Drive(1, 0, 0);
+#endif
+#endif
+}
+
+/** Restarts scanning after a bus suspend. */
+void Touch_Resume(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		adc_suspended = 0;
+		if (adc_idle)
+			Wake();
+	}
+}
+
+#if POWER_REMOTE_WAKEUP
+/** Checks the suspended panels for a touch, from the analog comparator output. With several panels
+ *  every call checks the one the comparator has been watching, then moves it on to the next.
+ *
+ *  \return Boolean \c true if a panel is touched.
+ */
+bool Touch_Detected(void)
+{
+	if (ACSR & _BV(ACO))
+		return true;
+
+#if (TOUCH_PANELS > 1)
+	NextDetectPanel();
+#endif
+	return false;
+}
+#endif
+
+/** Tells whether a complete scan frame is waiting for \ref Touch_Task, so the main loop does not
+ *  sleep on it.
+ *
+ *  \return Boolean \c true if a scan frame is ready.
+ */
+bool Touch_FramePending(void)
+{
+	return adc_frame_ready;
+}
+
+#if TOUCH_SETTLE_MEASURE
+/** Records one conversion of a settle curve measurement. Every phase of the first panel gets
+ *  \ref TOUCH_SETTLE_CURVE conversions straight after switching to it, in scan order, after which
+ *  scanning resumes with a fresh frame.
+ *
+ *  \param[in] readout  Conversion result
+ */
+static inline void SettleConversion(const uint16_t readout)
+{
+	settle_measurement.Curve[settle_phase][settle_index] = readout;
+	if (++settle_index < TOUCH_SETTLE_CURVE)
+		return;
+
+	settle_index = 0;
+	if (++settle_phase == ADC_PHASE_COUNT)
+	{
+		settle_recorded = 1;
+		adc_discard = adc_settle[0];
+		StartPhase(0, 0);
+#if (TOUCH_PANELS > 1)
+		drive_stamp[0] = adc_conversions;
+#endif
+		return;
+	}
+
+	StartPhase(0, settle_phase);
+}
+#endif
+
+/** Processes one conversion result, running the scan engine. In free running mode the next
+ *  conversion has already started with the previous channel when the ADC ISR fires, so the first
+ *  result after every phase switch is discarded; every further discarded conversion adds one
+ *  conversion time of settling for the new drive pattern. Oversampled phases then accumulate back
+ *  to back conversions on the same channel without further settling. A new ADC prescaler setting
+ *  is switched to between frames, where the conversion it disturbs is discarded anyway.
+ *
+ *  With several panels, each one is switched to its next drive pattern right after its step, and
+ *  only the settle time not yet covered by the other panels' steps is discarded when its turn comes.
+ */
+static inline void ScanConversion(void)
+{
+	static uint8_t  samples;
+	static uint16_t sum;
+#if TOUCH_OVERSAMPLE_BITS
+	static uint16_t lowest = UINT16_MAX;
+	static uint16_t highest;
+#endif
+
+	uint16_t readout = ADC;
+
+#if (TOUCH_PANELS > 1)
+	adc_conversions++;
+#endif
+
+#if TOUCH_SETTLE_MEASURE
+	if (settle_phase != ADC_PHASE_COUNT)
+	{
+		SettleConversion(readout);
+		return;
+	}
+#endif
+
+	if (adc_discard)
+	{
+		adc_discard--;
+		return;
+	}
+
+	sum += readout;
+#if TOUCH_OVERSAMPLE_BITS
+	if (readout < lowest)
+		lowest = readout;
+	if (readout > highest)
+		highest = readout;
+#endif
+	if (++samples < adc_phases[adc_panel][adc_phase].Count)
+		return;
+
+	touch_frame_t* frame = &touch_internals[adc_write_frame];
+
+	frame->Raw[adc_panel][adc_phase] = (sum >> adc_phases[adc_panel][adc_phase].Shift);
+	sum = 0;
+	samples = 0;
+
+#if TOUCH_OVERSAMPLE_BITS
+	if (!adc_phase || ((highest - lowest) > frame->Spread[adc_panel]))
+		frame->Spread[adc_panel] = (highest - lowest);
+	lowest = UINT16_MAX;
+	highest = 0;
+#endif
+
+#if (TOUCH_PANELS > 1)
+	uint8_t next = ((adc_phase + 1) < ADC_PHASE_COUNT) ? (adc_phase + 1) : 0;
+	bool    predrive = (adc_phases[adc_panel][next].Port != adc_phases[adc_panel][adc_phase].Port) ||
+	                   (adc_phases[adc_panel][next].Ddr != adc_phases[adc_panel][adc_phase].Ddr);
+
+#if TOUCH_SETTLE_MEASURE
+	// A settle measurement has to see the first panel switch into the first phase
+	if (!adc_panel && !next && settle_requested)
+		predrive = false;
+#endif
+
+	if (predrive)
+	{
+		Drive(adc_panel, adc_phases[adc_panel][next].Port, adc_phases[adc_panel][next].Ddr);
+		drive_stamp[adc_panel] = adc_conversions;
+	}
+
+	if (++adc_panel < TOUCH_PANELS)
+	{
+		StartStep();
+		return;
+	}
+
+	adc_panel = 0;
+#endif
+
+	if (++adc_phase == ADC_PHASE_COUNT)
+	{
+		frame->ScanTime = scan_clock;
+		frame->Stamp = TCNT1;
+		if (adc_frame_ready)
+			Profile_FrameOverrun();
+		for (uint8_t panel = 0; panel < TOUCH_PANELS; panel++)
+		{
+			RawStream_Push(frame->Raw[panel][ADC_PHASE_Y], frame->Raw[panel][ADC_PHASE_X],
+			               frame->Raw[panel][ADC_PHASE_STBY_YD], frame->Raw[panel][ADC_PHASE_STBY_XR],
+			               frame->Stamp, panel,
+			               (touch_panels[panel].Vals.pressed ? RAW_STREAM_FLAG_TOUCHED : 0) |
+			               (TOUCH_OVERSAMPLE_BITS << RAW_STREAM_FLAG_OVERSAMPLE_SHIFT));
+		}
+		adc_phase = 0;
+		adc_write_frame ^= 1;
+		adc_frame_ready = 1;
+
+		uint8_t prescaler_bits = adc_prescaler_bits;
+
+		LatchSettings();
+		if (adc_prescaler_bits != prescaler_bits)
+			ADCSRA = (ADCSRA & ~(_BV(ADIF) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | adc_prescaler_bits;
+
+		if (adc_idle_request)
+		{
+			StartDetect();
+			return;
+		}
+#if TOUCH_SETTLE_MEASURE
+		if (settle_requested)
+		{
+			settle_requested = 0;
+			settle_phase = 0;
+#if (TOUCH_PANELS > 1)
+			StartPhase(0, 0);
+#endif
+		}
+#endif
+	}
+
+#if (TOUCH_PANELS > 1)
+	StartStep();
+#else
+	StartPhase(0, adc_phase);
+	adc_discard = adc_settle[adc_phase];
+#endif
+}
+
+/** ADC conversion complete ISR, timed per scan phase when profiling. */
+ISR(ADC_vect)
+{
+	uint16_t start = Profile_Begin();
+	uint8_t  phase = adc_phase;
+
+	ScanConversion();
+
+	Profile_End(PROFILE_SECTION_ADC_Y + phase, start);
+}
+
+/** Estimates the touch plate resistance R = X * (STBY_YD / STBY_XR - 1), in the units of the
+ *  pressure thresholds. The divisor is normalized to 10 bits by shifting and its reciprocal looked
+ *  up, leaving two 16x16 bit multiplies.
+ *
+ *  \param[in] x10  X readout scaled to 10 bits
+ *  \param[in] yd   Standby Y plane readout
+ *  \param[in] xr   Standby X plane readout
+ *
+ *  \return Estimated resistance, \c UINT16_MAX when the panel is not touched at all.
+ */
+static uint16_t TouchResistance(const uint16_t x10, const uint16_t yd, const uint16_t xr)
+{
+	if (!xr || (yd < xr))
+		return UINT16_MAX;
+
+	uint16_t m = xr;
+	uint8_t shift = 0;
+	while (!(m & 0x200))
+	{
+		m <<= 1;
+		shift++;
+	}
+
+	uint16_t recip = pgm_read_word(&z_reciprocals[(m >> 3) & 0x3F]);
+	uint16_t t = ((uint32_t)x10 * (yd - xr)) >> 4;
+	uint32_t r = ((uint32_t)t * recip) >> (21 - shift);
+
+	return (r > UINT16_MAX) ? UINT16_MAX : r;
+}
+
+/** Advances the scan time clock, called once per USB frame. While the scan engine is idle, it also
+ *  wakes it for a contact that was already present when the comparator was armed, so it saw no
+ *  edge, and for a periodic poll frame. A poll frame is a single one, rearming the comparator at its
+ *  end unless \ref Touch_Task() finds a contact in it. With several panels the comparator watches
+ *  the next panel every millisecond.
+ */
+void Touch_MillisecondElapsed(void)
+{
+	scan_clock += 10;
+
+#if TOUCH_IDLE_DETECT
+	if (adc_idle && !adc_suspended)
+	{
+		if (ACSR & _BV(ACO))
+		{
+			Wake();
+		}
+		else if (++idle_poll_ms >= TOUCH_IDLE_POLL_MS)
+		{
+			Wake();
+			adc_idle_request = 1;
+		}
+#if (TOUCH_PANELS > 1)
+		else
+			NextDetectPanel();
+#endif
+	}
+#endif
+}
+
+/** Decides whether the first scan frame of a new contact can be reported right away. The contact
+ *  may have started while the frame was being scanned, leaving coordinates of a floating plate:
+ *  those sit at a rail, since every sense pin was driven in the phase before, or, when oversampled,
+ *  spread widely. The standby readout at the end of the frame must also show a firm press.
+ *
+ *  \param[in] frame  Scan frame with contact
+ *  \param[in] panel  Panel with contact
+ *  \param[in] r      Touch plate resistance estimate of the panel
+ *
+ *  \return Boolean \c true if the frame's coordinates can be trusted.
+ */
+static bool FirstContactValid(const touch_frame_t* const frame, const uint8_t panel, const uint16_t r)
+{
+#if TOUCH_FAST_TOUCHDOWN
+	if (r > Settings.ZConfident)
+		return false;
+
+	for (uint8_t phase = ADC_PHASE_Y; phase <= ADC_PHASE_X; phase++)
+	{
+		uint16_t c = (frame->Raw[panel][phase] >> TOUCH_OVERSAMPLE_BITS);
+
+		if ((c < Settings.RailMargin) || (c > (1023 - Settings.RailMargin)))
+			return false;
+	}
+
+#if TOUCH_OVERSAMPLE_BITS
+	if (frame->Spread[panel] > Settings.SettleSpread)
+		return false;
+#endif
+
+	return true;
+#else
+	(void)frame;
+	(void)panel;
+	(void)r;
+
+	return false;
+#endif
+}
+
+/** Returns whether two values differ by more than a dead-band. */
+static bool Moved(const uint16_t a, const uint16_t b, const uint16_t deadband)
+{
+	return ((a > b) ? (a - b) : (b - a)) > deadband;
+}
+
+#if TOUCH_SETTLE_MEASURE
+/** Finds the settle conversions of every phase from a recorded settle measurement, and requests
+ *  them as new settings. A phase has settled from the first conversion on after which every one
+ *  stays within \ref TOUCH_SETTLE_TOLERANCE of the final value, the mean of the last four. The
+ *  measurement is rejected if the final values fail the press test.
+ */
+static void SettleAnalyse(void)
+{
+	Settings_t settings = *Settings_GetRequested();
+	uint16_t   final[ADC_PHASE_COUNT];
+
+	for (uint8_t phase = 0; phase < ADC_PHASE_COUNT; phase++)
+	{
+		uint8_t settle = TOUCH_SETTLE_CURVE;
+
+		final[phase] = 2;
+		for (uint8_t i = (TOUCH_SETTLE_CURVE - 4); i < TOUCH_SETTLE_CURVE; i++)
+			final[phase] += settle_measurement.Curve[phase][i];
+		final[phase] /= 4;
+
+		while ((settle > 1) &&
+		       !(Moved(settle_measurement.Curve[phase][settle - 1], final[phase], TOUCH_SETTLE_TOLERANCE)))
+			settle--;
+
+		settings.Settle[phase] = (settle > TOUCH_SETTLE_MAX) ? TOUCH_SETTLE_MAX : settle;
+		settle_measurement.Settle[phase] = settings.Settle[phase];
+	}
+
+	uint16_t r = TouchResistance(final[PANEL_PLATE_X_PHASE(0)] ^ PANEL_PLATE_X_XOR(0),
+	                             final[ADC_PHASE_STBY_YD], final[ADC_PHASE_STBY_XR]);
+
+	if ((r <= settings.ZRelease) && Settings_Request(&settings))
+		settle_measurement.State = TOUCH_SETTLE_APPLIED;
+	else
+		settle_measurement.State = TOUCH_SETTLE_REJECTED;
+}
+
+/** Starts a settle curve measurement at the next scan frame boundary. Scanning pauses for the
+ *  \ref TOUCH_SETTLE_CURVE conversions of every phase, during which the first panel must stay
+ *  pressed; the settle conversions found are then requested as new settings for every panel.
+ *
+ *  \return Boolean \c true if the measurement was started, \c false if the panel is not pressed or
+ *          a measurement is already running.
+ */
+bool Touch_MeasureSettle(void)
+{
+	if (!touch_panels[0].Vals.pressed || (settle_measurement.State == TOUCH_SETTLE_RUNNING))
+		return false;
+
+	settle_measurement.State = TOUCH_SETTLE_RUNNING;
+	settle_requested = 1;
+	return true;
+}
+
+/** Returns the latest settle curve measurement. */
+const Touch_SettleMeasurement_t* Touch_GetSettleMeasurement(void)
+{
+	return &settle_measurement;
+}
+#endif
+
+/** Processes a panel's part of a scan frame into its reported touch values.
+ *
+ *  \param[in] frame  Newest complete scan frame
+ *  \param[in] panel  Panel to process
+ *
+ *  \return Touch plate resistance estimate of the panel.
+ */
+static uint16_t ProcessPanel(const touch_frame_t* const frame, const uint8_t panel)
+{
+	touch_panel_t* const state = &touch_panels[panel];
+	touch_vals_t* const  vals = &state->Vals;
+	const uint16_t*      raw = frame->Raw[panel];
+
+#if (TOUCH_PANELS > 1)
+	uint16_t plate_x = panel ? ((raw[PANEL_PLATE_X_PHASE(1)] >> TOUCH_OVERSAMPLE_BITS) ^ PANEL_PLATE_X_XOR(1))
+	                         : ((raw[PANEL_PLATE_X_PHASE(0)] >> TOUCH_OVERSAMPLE_BITS) ^ PANEL_PLATE_X_XOR(0));
+#else
+	uint16_t plate_x = (raw[PANEL_PLATE_X_PHASE(0)] >> TOUCH_OVERSAMPLE_BITS) ^ PANEL_PLATE_X_XOR(0);
+#endif
+	uint16_t r = TouchResistance(plate_x, raw[ADC_PHASE_STBY_YD], raw[ADC_PHASE_STBY_XR]);
+
+	// Press and release thresholds differ so a touch hovering at the limit doesn't chatter
+	if (r > (state->FullUpdate ? Settings.ZRelease : Settings.ZPress))
+	{
+		vals->pressed = 0;
+		vals->Z = 0;
+		vals->ScanTime = frame->ScanTime;
+		state->FullUpdate = 0;
+	}
+	else
+	{
+		if(state->FullUpdate || FirstContactValid(frame, panel, r))
+		{
+#if TOUCH_FILTER
+			if (!vals->pressed)
+			{
+				TouchFilter_Reset(&state->FilterX, raw[ADC_PHASE_X]);
+				TouchFilter_Reset(&state->FilterY, raw[ADC_PHASE_Y]);
+			}
+
+			vals->X = TouchFilter_Apply(&state->FilterX, raw[ADC_PHASE_X]);
+			vals->Y = TouchFilter_Apply(&state->FilterY, raw[ADC_PHASE_Y]);
+#else
+			vals->X = raw[ADC_PHASE_X];
+			vals->Y = raw[ADC_PHASE_Y];
+#endif
+#if TOUCH_PREDICT
+			if (!vals->pressed)
+			{
+				TouchPredict_Reset(&state->PredictX, vals->X);
+				TouchPredict_Reset(&state->PredictY, vals->Y);
+			}
+
+			vals->X = TouchPredict_Apply(&state->PredictX, vals->X, TOUCH_PREDICT_HORIZON_FRAMES);
+			vals->Y = TouchPredict_Apply(&state->PredictY, vals->Y, TOUCH_PREDICT_HORIZON_FRAMES);
+#endif
+#if TOUCH_CALIBRATION
+			state->UncalibratedX = vals->X;
+			state->UncalibratedY = vals->Y;
+			Calibration_Apply(panel, &vals->X, &vals->Y);
+#endif
+			vals->Z = TOUCH_Z_MAXIMUM - ((r > TOUCH_Z_MAXIMUM) ? TOUCH_Z_MAXIMUM : r);
+			vals->ScanTime = frame->ScanTime;
+			vals->pressed = 1;
+		}
+		state->FullUpdate = 1;
+	}
+
+	vals->ScanStamp = frame->Stamp;
+	vals->FilterStamp = Timestamp_Now();
+
+	// A full queue drops its oldest sample
+	state->Queue[state->QueueHead++ & (TOUCH_REPORT_QUEUE - 1)] = *vals;
+	if ((uint8_t)(state->QueueHead - state->QueueTail) > TOUCH_REPORT_QUEUE)
+		state->QueueTail++;
+
+	return r;
+}
+
+/** Processes the newest complete scan frame, if any, into the reported touch values of every panel.
+ *
+ *  \return Boolean \c true if a new frame was processed, \c false otherwise.
+ */
+bool Touch_Task(void)
+{
+	touch_frame_t frame;
+
+#if TOUCH_SETTLE_MEASURE
+	if (settle_recorded)
+	{
+		settle_recorded = 0;
+		SettleAnalyse();
+	}
+#endif
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		if (!adc_frame_ready)
+			return false;
+		adc_frame_ready = 0;
+		frame = touch_internals[adc_write_frame ^ 1];
+	}
+
+	Settings_Apply();
+
+#if TOUCH_IDLE_DETECT
+	bool idle = true;
+#endif
+
+	for (uint8_t panel = 0; panel < TOUCH_PANELS; panel++)
+	{
+		uint16_t r = ProcessPanel(&frame, panel);
+
+#if TOUCH_IDLE_DETECT
+		// Only panels without any contact idle; a light one keeps being scanned
+		touch_panel_t* const state = &touch_panels[panel];
+
+		if (r != UINT16_MAX)
+		{
+			state->IdleFrames = 0;
+			idle = false;
+		}
+		else if (state->IdleFrames < IDLE_FRAMES)
+		{
+			state->IdleFrames++;
+			idle = false;
+		}
+#else
+		(void)r;
+#endif
+	}
+
+#if TOUCH_IDLE_DETECT
+	if (idle)
+	{
+		adc_idle_request = 1;
+	}
+	else
+	{
+		/* A single poll frame found a contact the comparator missed, keep scanning it */
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			if (adc_idle && !adc_suspended)
+			  Wake();
+		}
+	}
+#endif
+
+	return true;
+}
+
+/** Returns the filtered, uncalibrated coordinates of a panel's current touch, for recording
+ *  calibration reference points.
+ *
+ *  \param[in]  Panel  Panel to read, below \ref TOUCH_PANELS
+ *  \param[out] X      Uncalibrated X coordinate
+ *  \param[out] Y      Uncalibrated Y coordinate
+ *
+ *  \return Boolean \c true if the panel is pressed, \c false otherwise, leaving the coordinates unset.
+ */
+bool Touch_GetUncalibrated(const uint8_t Panel, uint16_t* const X, uint16_t* const Y)
+{
+#if TOUCH_CALIBRATION
+	if (!touch_panels[Panel].Vals.pressed)
+		return false;
+
+	*X = touch_panels[Panel].UncalibratedX;
+	*Y = touch_panels[Panel].UncalibratedY;
+	return true;
+#else
+	(void)Panel;
+	(void)X;
+	(void)Y;
+	return false;
+#endif
+}
+
+#if TOUCH_REPORT_BATCH
+/** Appends a pressed sample to the batch of the next report, dropping the oldest one of a full batch.
+ *
+ *  \param[in,out] state  Panel the samples belong to
+ *  \param[in,out] batch  Samples batched so far
+ *  \param[in]     count  Number of samples in \p batch
+ *
+ *  \return New number of samples in \p batch.
+ */
+static uint8_t BatchSample(touch_panel_t* const state, USB_TouchReport_Sample_t* const batch, uint8_t count)
+{
+	if (count == TOUCH_REPORT_BATCH)
+	{
+		for (uint8_t i = 1; i < TOUCH_REPORT_BATCH; i++)
+			batch[i - 1] = batch[i];
+		count--;
+	}
+
+	batch[count].X = state->Reported.X;
+	batch[count].Y = state->Reported.Y;
+	batch[count].Delta = state->Reported.ScanStamp - state->BatchStamp;
+	state->BatchStamp = state->Reported.ScanStamp;
+
+	return count + 1;
+}
+#endif
+
+/** Fills a HID report from a panel's report queue. Moves are coalesced into the freshest queued
+ *  sample, but a press or release is never skipped: the queue is only drained up to the first sample
+ *  whose tip state differs from the last report. Changes within the dead-bands repeat the previous
+ *  report verbatim, so the HID driver's report comparison suppresses it.
+ *
+ *  With \ref TOUCH_REPORT_BATCH, every drained pressed sample also goes into the report's batch,
+ *  bypassing the dead-bands; a new batch bumps the sequence number, so the report is sent.
+ *
+ *  \param[in]  Panel        Panel to report, below \ref TOUCH_PANELS
+ *  \param[out] TouchReport  Report to fill
+ *  \param[in]  Endpoint     Whether the report goes out on the panel's IN endpoint; only those are
+ *                           timed, not reports answering a GET_REPORT control request
+ *
+ *  \return Boolean \c true if the tip state changed and the report must be sent.
+ */
+bool Touch_CreateReport(const uint8_t Panel, USB_TouchReport_Data_t* const TouchReport, const bool Endpoint)
+{
+	touch_panel_t* const    state = &touch_panels[Panel];
+	touch_vals_t* const     reported = &state->Reported;
+	USB_TouchReport_Data_t* last_report = &state->LastReport;
+#if TOUCH_REPORT_BATCH
+	USB_TouchReport_Sample_t batch[TOUCH_REPORT_BATCH];
+	uint8_t batched = 0;
+#endif
+
+	while (state->QueueTail != state->QueueHead)
+	{
+		uint8_t tip = reported->pressed;
+
+		*reported = state->Queue[state->QueueTail++ & (TOUCH_REPORT_QUEUE - 1)];
+#if TOUCH_REPORT_BATCH
+		if (reported->pressed)
+			batched = BatchSample(state, batch, batched);
+#endif
+		if (reported->pressed != tip)
+			break;
+	}
+
+#if TOUCH_REPORT_BATCH
+	if (batched)
+	{
+		last_report->Sequence++;
+		last_report->SampleCount = batched;
+		for (uint8_t i = 0; i < batched; i++)
+			last_report->Samples[i] = batch[i];
+	}
+#endif
+
+	uint8_t flags = reported->pressed ? (TOUCH_REPORT_TIP | TOUCH_REPORT_IN_RANGE) : 0;
+	bool tip_changed = (flags != last_report->Flags);
+
+	if (tip_changed ||
+		Moved(reported->X, last_report->X, Settings.Deadband) ||
+		Moved(reported->Y, last_report->Y, Settings.Deadband) ||
+		Moved(reported->Z, last_report->Pressure, Settings.ZDeadband))
+	{
+		last_report->Y = reported->Y;
+		last_report->X = reported->X;
+
+		last_report->Pressure = reported->Z;
+		last_report->ScanTime = reported->ScanTime;
+
+		last_report->Flags = flags;
+
+		if (Endpoint)
+			Latency_ReportCreated(Panel, reported->ScanStamp, reported->FilterStamp);
+	}
+
+	*TouchReport = *last_report;
+	return tip_changed;
+}
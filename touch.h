@@ -0,0 +1,183 @@
+/** \file
+ *
+ *  Header file for touch.c.
+ */
+
+#ifndef _TOUCH_H_
+#define _TOUCH_H_
+
+	/* Includes: */
+		#include <avr/io.h>
+		#include <avr/interrupt.h>
+		#include <avr/pgmspace.h>
+		#include <util/atomic.h>
+		#include <stdbool.h>
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+		#include "panel.h"
+		#include "touch_filter.h"
+		#include "touch_predict.h"
+		#include "calibration.h"
+		#include "settings.h"
+		#include "latency.h"
+		#include "profile.h"
+		#include "raw_stream.h"
+		#include "timestamp.h"
+
+	/* Macros: */
+		/** Report flag set while the panel is pressed. */
+		#define TOUCH_REPORT_TIP          (1 << 0)
+
+		/** Report flag set while a contact is in range, which a resistive panel can only tell while
+		 *  it is pressed.
+		 */
+		#define TOUCH_REPORT_IN_RANGE     (1 << 1)
+
+		/** Default ADC clock prescaler of the scan engine as a power of two, planned from \c F_CPU as
+		 *  the fastest ADC clock not above \ref TOUCH_ADC_CLOCK_HZ. Tunable at runtime through
+		 *  \ref Settings_t.
+		 */
+		#define TOUCH_ADC_PRESCALER_BITS  (((F_CPU /  2) <= TOUCH_ADC_CLOCK_HZ) ? 1 : \
+		                                   ((F_CPU /  4) <= TOUCH_ADC_CLOCK_HZ) ? 2 : \
+		                                   ((F_CPU /  8) <= TOUCH_ADC_CLOCK_HZ) ? 3 : \
+		                                   ((F_CPU / 16) <= TOUCH_ADC_CLOCK_HZ) ? 4 : \
+		                                   ((F_CPU / 32) <= TOUCH_ADC_CLOCK_HZ) ? 5 : \
+		                                   ((F_CPU / 64) <= TOUCH_ADC_CLOCK_HZ) ? 6 : 7)
+
+		#if ((F_CPU / 128) > TOUCH_ADC_CLOCK_HZ)
+			#warning F_CPU is too fast to reach TOUCH_ADC_CLOCK_HZ, the ADC runs at F_CPU / 128.
+		#endif
+
+		/** Default ADC clock prescaler of the scan engine. */
+		#define TOUCH_ADC_PRESCALER       (1 << TOUCH_ADC_PRESCALER_BITS)
+
+		/** Duration of one free running conversion in microseconds, 13 ADC clocks, at the default
+		 *  prescaler.
+		 */
+		#define TOUCH_CONVERSION_US       (13UL * TOUCH_ADC_PRESCALER / (F_CPU / 1000000))
+
+		/** Conversions discarded after a phase switch for a settle time of \p us microseconds: the
+		 *  one already running on the previous phase, plus one per further conversion time.
+		 */
+		#define TOUCH_SETTLE_CONVERSIONS(us) \
+		                                  (((us) > TOUCH_CONVERSION_US) ? \
+		                                   (((us) + TOUCH_CONVERSION_US - 1) / TOUCH_CONVERSION_US) : 1)
+
+		/** Largest number of settle conversions of a scan phase. */
+		#define TOUCH_SETTLE_MAX          15
+
+		/** Conversions recorded per scan phase when measuring the settle curves. */
+		#define TOUCH_SETTLE_CURVE        16
+
+		/** Default settle conversions of the coordinate and standby phases. */
+		#define TOUCH_SETTLE_XY           TOUCH_SETTLE_CONVERSIONS(TOUCH_SETTLE_XY_US)
+		#define TOUCH_SETTLE_STBY         TOUCH_SETTLE_CONVERSIONS(TOUCH_SETTLE_STBY_US)
+
+		#if ((TOUCH_SETTLE_XY > TOUCH_SETTLE_MAX) || (TOUCH_SETTLE_STBY > TOUCH_SETTLE_MAX))
+			#error Settle times must not exceed TOUCH_SETTLE_MAX conversions.
+		#endif
+
+		#if ((TOUCH_PANELS < 1) || (TOUCH_PANELS > 2))
+			#error TOUCH_PANELS must be 1 or 2.
+		#endif
+
+		/** Conversions in one complete scan of every panel at the default settle times, including the
+		 *  discarded ones. Interleaved panels settle while the others convert, which at the default
+		 *  settle times leaves only the conversion running on the previous channel to discard.
+		 */
+		#if (TOUCH_PANELS > 1)
+			#define TOUCH_SCAN_CONVERSIONS (TOUCH_PANELS * (2 * ((1 << (2 * TOUCH_OVERSAMPLE_BITS)) + 1) + 2 * (1 + 1)))
+		#else
+			#define TOUCH_SCAN_CONVERSIONS (2 * ((1 << (2 * TOUCH_OVERSAMPLE_BITS)) + TOUCH_SETTLE_XY) + \
+			                                2 * (1 + TOUCH_SETTLE_STBY))
+		#endif
+
+		/** Duration of one complete scan in microseconds, 13 ADC clocks per conversion, at the default
+		 *  prescaler and settle times.
+		 */
+		#define TOUCH_SCAN_PERIOD_US      ((uint32_t)TOUCH_SCAN_CONVERSIONS * 13 * TOUCH_ADC_PRESCALER / \
+		                                   (F_CPU / 1000000))
+
+		#if (TOUCH_REPORT_BATCH > 8)
+			#error TOUCH_REPORT_BATCH must not exceed 8 samples.
+		#elif (TOUCH_REPORT_BATCH > TOUCH_REPORT_QUEUE)
+			#error TOUCH_REPORT_QUEUE must hold at least TOUCH_REPORT_BATCH samples.
+		#endif
+
+	/* Enums: */
+		/** Scan phases of one complete panel scan, in scan order. */
+		enum AdcPhase
+		{
+			ADC_PHASE_Y, /**< Y plane driven, Y coordinate sensed on the X plane. */
+			ADC_PHASE_X, /**< X plane driven, X coordinate sensed on the Y plane. */
+			ADC_PHASE_STBY_YD, /**< Standby drive, Y plane voltage for the pressure test. */
+			ADC_PHASE_STBY_XR, /**< Standby drive, X plane voltage for the pressure test. */
+			ADC_PHASE_COUNT,
+		};
+
+		/** States of a settle curve measurement. */
+		enum TouchSettleStates_t
+		{
+			TOUCH_SETTLE_IDLE, /**< No measurement made yet. */
+			TOUCH_SETTLE_RUNNING, /**< Measurement requested or in progress. */
+			TOUCH_SETTLE_APPLIED, /**< Measured, and the settle conversions found requested. */
+			TOUCH_SETTLE_REJECTED, /**< Measured, but the panel was not pressed throughout. */
+		};
+
+	/* Type Defines: */
+		/** Type define for a coordinate sample of a batched touch report. */
+		typedef struct
+		{
+			uint16_t X; /**< Absolute X coordinate of the sample. */
+			uint16_t Y; /**< Absolute Y coordinate of the sample. */
+			uint16_t Delta; /**< Microseconds since the previous batched sample,
+			                 *   modulo 65536. */
+		} __attribute__((packed)) USB_TouchReport_Sample_t;
+
+		/** Type define for the touch screen HID input report sent to the host. */
+		typedef struct
+		{
+			uint8_t  Flags; /**< Mask of TOUCH_REPORT_* contact state flags. */
+			uint8_t  ContactID; /**< Contact identifier. */
+			uint16_t X; /**< Absolute X coordinate of the contact. */
+			uint16_t Y; /**< Absolute Y coordinate of the contact. */
+			uint16_t Pressure; /**< Tip pressure, zero when not pressed. */
+			uint16_t ScanTime; /**< Time of the scan in 100 us units, wrapping. */
+			uint8_t  ContactCount; /**< Number of contacts in the report. */
+		#if TOUCH_REPORT_BATCH
+			uint8_t  Sequence; /**< Incremented with every new batch of samples, wrapping. */
+			uint8_t  SampleCount; /**< Number of valid entries in \ref Samples. */
+			USB_TouchReport_Sample_t Samples[TOUCH_REPORT_BATCH]; /**< Pressed samples since the previous
+			                                                       *   batch, oldest first. */
+		#endif
+		} __attribute__((packed)) USB_TouchReport_Data_t;
+
+		/** Type define for the result of a settle curve measurement. */
+		typedef struct
+		{
+			uint8_t  State; /**< A \ref TouchSettleStates_t value. */
+			uint8_t  Settle[ADC_PHASE_COUNT]; /**< Settle conversions found for each scan phase. */
+			uint16_t Curve[ADC_PHASE_COUNT][TOUCH_SETTLE_CURVE]; /**< Conversions after switching to each
+			                                                      *   phase, the first one still running
+			                                                      *   on the previous phase. */
+		} __attribute__((packed)) Touch_SettleMeasurement_t;
+
+	/* Function Prototypes: */
+		void Touch_Init(void);
+		bool Touch_Task(void);
+		void Touch_MillisecondElapsed(void);
+		bool Touch_CreateReport(const uint8_t Panel, USB_TouchReport_Data_t* const TouchReport, const bool Endpoint);
+		bool Touch_GetUncalibrated(const uint8_t Panel, uint16_t* const X, uint16_t* const Y);
+		bool Touch_FramePending(void);
+		void Touch_Suspend(void);
+		void Touch_Resume(void);
+		#if POWER_REMOTE_WAKEUP
+		bool Touch_Detected(void);
+		#endif
+		#if TOUCH_SETTLE_MEASURE
+		bool Touch_MeasureSettle(void);
+		const Touch_SettleMeasurement_t* Touch_GetSettleMeasurement(void);
+		#endif
+
+#endif
@@ -0,0 +1,81 @@
+/** \file
+ *
+ *  Fixed point coordinate filter: a short median window rejects single sample spikes, followed
+ *  by a first order IIR whose strength adapts to the touch velocity. All arithmetic is done in
+ *  8/16-bit integers so it stays cheap enough to run on every scan frame.
+ */
+
+#include "touch_filter.h"
+
+#if (TOUCH_OVERSAMPLE_BITS < 0) || (TOUCH_OVERSAMPLE_BITS > 2)
+	#error TOUCH_OVERSAMPLE_BITS must be between 0 and 2.
+#endif
+
+#if (TOUCH_FILTER_MEDIAN != 1) && (TOUCH_FILTER_MEDIAN != 3) && (TOUCH_FILTER_MEDIAN != 5)
+	#error TOUCH_FILTER_MEDIAN must be 1, 3 or 5.
+#endif
+
+static uint16_t Median(const uint16_t* const History)
+{
+#if (TOUCH_FILTER_MEDIAN == 1)
+	return History[0];
+#else
+	uint16_t sorted[TOUCH_FILTER_MEDIAN];
+
+	for (uint8_t i = 0; i < TOUCH_FILTER_MEDIAN; i++)
+	{
+		uint16_t value = History[i];
+		uint8_t  j     = i;
+
+		for (; j && (sorted[j - 1] > value); j--)
+		  sorted[j] = sorted[j - 1];
+
+		sorted[j] = value;
+	}
+
+	return sorted[TOUCH_FILTER_MEDIAN / 2];
+#endif
+}
+
+/** Restarts the filter on a new contact, so no history of a previous touch leaks into it.
+ *
+ *  \param[out] Axis    Filter state to reset
+ *  \param[in]  Sample  First coordinate of the new contact
+ */
+void TouchFilter_Reset(TouchFilterAxis_t* const Axis, const uint16_t Sample)
+{
+	for (uint8_t i = 0; i < TOUCH_FILTER_MEDIAN; i++)
+	  Axis->History[i] = Sample;
+
+	Axis->State = (Sample << TOUCH_FILTER_FRAC_BITS);
+}
+
+/** Runs one coordinate sample through the filter.
+ *
+ *  \param[in,out] Axis    Filter state of the coordinate axis
+ *  \param[in]     Sample  Raw coordinate
+ *
+ *  \return Filtered coordinate.
+ */
+uint16_t TouchFilter_Apply(TouchFilterAxis_t* const Axis, const uint16_t Sample)
+{
+	for (uint8_t i = 1; i < TOUCH_FILTER_MEDIAN; i++)
+	  Axis->History[i - 1] = Axis->History[i];
+
+	Axis->History[TOUCH_FILTER_MEDIAN - 1] = Sample;
+
+	int16_t  diff  = (int16_t)((uint16_t)(Median(Axis->History) << TOUCH_FILTER_FRAC_BITS) - Axis->State);
+	uint16_t delta = ((diff < 0) ? -diff : diff) >> TOUCH_FILTER_FRAC_BITS;
+	uint8_t  shift = Settings.FilterMaxShift;
+
+	// Every doubling of the velocity above the still threshold halves the smoothing
+	while (shift && (delta > (Settings.FilterStillDelta << TOUCH_OVERSAMPLE_BITS)))
+	{
+		delta >>= 1;
+		shift--;
+	}
+
+	Axis->State += (diff >> shift);
+
+	return (Axis->State + (1 << (TOUCH_FILTER_FRAC_BITS - 1))) >> TOUCH_FILTER_FRAC_BITS;
+}
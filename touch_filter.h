@@ -0,0 +1,33 @@
+/** \file
+ *
+ *  Header file for touch_filter.c.
+ */
+
+#ifndef _TOUCH_FILTER_H_
+#define _TOUCH_FILTER_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+		#include "settings.h"
+
+	/* Macros: */
+		/** Fractional bits kept in the IIR state, chosen so that a full scale coordinate still fits
+		 *  a signed 16-bit difference.
+		 */
+		#define TOUCH_FILTER_FRAC_BITS    (15 - TOUCH_RESOLUTION_BITS)
+
+	/* Type Defines: */
+		/** Filter state of a single coordinate axis. */
+		typedef struct
+		{
+			uint16_t History[TOUCH_FILTER_MEDIAN]; /**< Median window, oldest sample first. */
+			uint16_t State; /**< IIR output, with \ref TOUCH_FILTER_FRAC_BITS fractional bits. */
+		} TouchFilterAxis_t;
+
+	/* Function Prototypes: */
+		void TouchFilter_Reset(TouchFilterAxis_t* const Axis, const uint16_t Sample);
+		uint16_t TouchFilter_Apply(TouchFilterAxis_t* const Axis, const uint16_t Sample);
+
+#endif
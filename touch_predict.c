@@ -0,0 +1,70 @@
+/** \file
+ *
+ *  Fixed point alpha-beta motion predictor. It tracks the position and velocity of each filtered
+ *  coordinate and extrapolates it over the pipeline latency, so the host sees the touch where it
+ *  is by the time the report arrives rather than where it was scanned. With a fixed scan period
+ *  the velocity is kept in counts per frame, which leaves shifts and one multiply per axis.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "touch_predict.h"
+
+/** Restarts the predictor on a new contact. The prediction stays off until the velocity estimate
+ *  has settled, as there is no motion history to extrapolate from.
+ *
+ *  \param[out] Axis    Predictor state to reset
+ *  \param[in]  Sample  First filtered coordinate of the new contact
+ */
+void TouchPredict_Reset(TouchPredictAxis_t* const Axis, const uint16_t Sample)
+{
+	Axis->Position = ((int32_t)Sample << TOUCH_PREDICT_FRAC_BITS);
+	Axis->Velocity = 0;
+	Axis->Hold     = TOUCH_PREDICT_HOLD;
+}
+
+/** Runs one filtered coordinate through the predictor. When the coordinate falls behind the
+ *  predicted one by more than a frame's worth of motion, or the velocity changes sign, the touch
+ *  is about to reverse or stop; the prediction is then switched off for a while, as it would
+ *  overshoot.
+ *
+ *  \param[in,out] Axis           Predictor state of the coordinate axis
+ *  \param[in]     Sample         Filtered coordinate
+ *  \param[in]     HorizonFrames  Prediction horizon in scan frames, with \ref TOUCH_PREDICT_FRAC_BITS
+ *                                fractional bits
+ *
+ *  \return Predicted coordinate, or \p Sample itself while the prediction is off.
+ */
+uint16_t TouchPredict_Apply(TouchPredictAxis_t* const Axis, const uint16_t Sample,
+                            const uint16_t HorizonFrames)
+{
+	int32_t predicted = Axis->Position + Axis->Velocity;
+	int32_t residual  = ((int32_t)Sample << TOUCH_PREDICT_FRAC_BITS) - predicted;
+	int32_t velocity  = Axis->Velocity + (residual >> TOUCH_PREDICT_BETA_SHIFT);
+
+	bool reversing = ((velocity ^ Axis->Velocity) < 0) ||
+	                 (((residual ^ Axis->Velocity) < 0) && (labs(residual) > labs(Axis->Velocity)));
+
+	Axis->Position = predicted + (residual >> TOUCH_PREDICT_ALPHA_SHIFT);
+	Axis->Velocity = velocity;
+
+	if (reversing)
+		Axis->Hold = TOUCH_PREDICT_HOLD;
+
+	if (Axis->Hold)
+	{
+		Axis->Hold--;
+		return Sample;
+	}
+
+	int32_t out = Axis->Position + ((velocity * HorizonFrames) >> TOUCH_PREDICT_FRAC_BITS);
+
+	out = (out + (1 << (TOUCH_PREDICT_FRAC_BITS - 1))) >> TOUCH_PREDICT_FRAC_BITS;
+	if (out < 0)
+		return 0;
+	if (out > TOUCH_LOGICAL_MAXIMUM)
+		return TOUCH_LOGICAL_MAXIMUM;
+
+	return out;
+}
@@ -0,0 +1,32 @@
+/** \file
+ *
+ *  Header file for touch_predict.c.
+ */
+
+#ifndef _TOUCH_PREDICT_H_
+#define _TOUCH_PREDICT_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+		#include "Config/AppConfig.h"
+
+	/* Macros: */
+		/** Fractional bits of the predictor's position and velocity state. */
+		#define TOUCH_PREDICT_FRAC_BITS    8
+
+	/* Type Defines: */
+		/** Predictor state of a single coordinate axis. */
+		typedef struct
+		{
+			int32_t Position; /**< Position estimate, with \ref TOUCH_PREDICT_FRAC_BITS fractional bits. */
+			int32_t Velocity; /**< Velocity estimate in counts per scan frame, likewise. */
+			uint8_t Hold; /**< Frames left with the prediction switched off. */
+		} TouchPredictAxis_t;
+
+	/* Function Prototypes: */
+		void TouchPredict_Reset(TouchPredictAxis_t* const Axis, const uint16_t Sample);
+		uint16_t TouchPredict_Apply(TouchPredictAxis_t* const Axis, const uint16_t Sample,
+		                            const uint16_t HorizonFrames);
+
+#endif
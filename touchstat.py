@@ -0,0 +1,347 @@
+#!/usr/bin/env python3
+"""Reads the touch controller's built-in statistics over its vendor control requests, decodes
+its raw sample stream and batched touch reports, calibrates it and tunes its settings."""
+
+import argparse, fcntl, os, struct, sys, time
+
+import usb.core
+import usb.util
+
+VENDOR_ID = 0x03eb
+PRODUCT_ID = 0x2040
+
+VENDOR_REQ_GET_LATENCY = 0x02
+VENDOR_REQ_GET_PROFILE = 0x03
+VENDOR_REQ_RAW_STREAM = 0x04
+VENDOR_REQ_CALIBRATION = 0x05
+VENDOR_REQ_CALIBRATE_POINT = 0x06
+VENDOR_REQ_MEASURE_SETTLE = 0x07
+
+LATENCY_STAGES = ('scan->filter', 'filter->report', 'report->host', 'total')
+LATENCY_HISTOGRAM_BINS = 8
+
+PROFILE_SECTIONS = ('adc Y', 'adc X', 'adc STBY_YD', 'adc STBY_XR', 'sof', 'touch task', 'hid task')
+PROFILE_SOF = 4
+CYCLES_PER_US = 8
+
+RAW_EPADDR = 0x82
+RAW_INTERFACE = 1
+RAW_SAMPLE_SIZE = 8
+
+TOUCH_REPORT_ID = 1
+SETTINGS_REPORT_ID = 2
+
+REPORT_HEADER = struct.Struct('<BBHHHHBBB')
+REPORT_SAMPLE = struct.Struct('<HHH')
+REPORT_TIP = 0x01
+
+CALIBRATION_MATRIX = struct.Struct('<6i')
+CALIBRATION_FRAC_BITS = 12
+SETTINGS = struct.Struct('<HHHBBBBBBBBBBB')
+SETTINGS_FIELDS = ('z_press', 'z_release', 'z_confident', 'rail_margin', 'settle_spread', 'deadband',
+                   'z_deadband', 'filter_max_shift', 'filter_still_delta', 'adc_prescaler_bits',
+                   'settle_y', 'settle_x', 'settle_stby_yd', 'settle_stby_xr')
+
+SCAN_PHASES = ('Y', 'X', 'STBY_YD', 'STBY_XR')
+SETTLE_CURVE = 16
+SETTLE_MEASUREMENT = struct.Struct('<B4B%dH' % (len(SCAN_PHASES) * SETTLE_CURVE))
+SETTLE_STATES = ('none', 'running', 'applied', 'rejected, panel released')
+
+# Reference points as fractions of the reported range, spread out and not collinear
+CALIBRATION_TARGETS = ((0.1, 0.1), (0.9, 0.5), (0.5, 0.9))
+
+def vendor_in(dev, request, value, length, index=0):
+    return bytes(dev.ctrl_transfer(usb.util.CTRL_IN | usb.util.CTRL_TYPE_VENDOR | usb.util.CTRL_RECIPIENT_DEVICE,
+                                   request, value, index, length))
+
+def vendor_out(dev, request, value, data=None, index=0):
+    dev.ctrl_transfer(usb.util.CTRL_OUT | usb.util.CTRL_TYPE_VENDOR | usb.util.CTRL_RECIPIENT_DEVICE,
+                      request, value, index, data)
+
+def decode_raw(sample):
+    """Unpacks an 8 byte raw stream sample into (stamp, panel, y, x, stby_yd, stby_xr, flags). The
+    low bit of the timestamp carries the panel."""
+    stamp, bits = struct.unpack('<HQ', sample + b'\0\0')
+    return (stamp & ~1, stamp & 1, bits & 0xFFF, (bits >> 12) & 0xFFF, (bits >> 24) & 0x3FF, (bits >> 34) & 0x3FF,
+            (bits >> 44) & 0xF)
+
+def latency(dev, args):
+    n = len(LATENCY_STAGES)
+    fmt = '<H%dH%dH%dI%dH' % (n, n, n, LATENCY_HISTOGRAM_BINS)
+    data = vendor_in(dev, VENDOR_REQ_GET_LATENCY, 1 if args.reset else 0, struct.calcsize(fmt))
+    fields = struct.unpack(fmt, data)
+    samples = fields[0]
+    mins, maxs, sums = fields[1:1 + n], fields[1 + n:1 + 2 * n], fields[1 + 2 * n:1 + 3 * n]
+    histogram = fields[1 + 3 * n:]
+
+    print('%d reports measured' % samples)
+    if not samples:
+        return
+    print('%-16s %8s %8s %8s' % ('stage [us]', 'min', 'avg', 'max'))
+    for i, stage in enumerate(LATENCY_STAGES):
+        print('%-16s %8d %8d %8d' % (stage, mins[i], sums[i] // samples, maxs[i]))
+    print('total latency histogram:')
+    for i, count in enumerate(histogram):
+        label = '>=%d ms' % i if i == LATENCY_HISTOGRAM_BINS - 1 else '%d-%d ms' % (i, i + 1)
+        print('  %-8s %6d %s' % (label, count, '#' * (60 * count // samples)))
+
+def profile(dev, args):
+    n = len(PROFILE_SECTIONS)
+    fmt = '<%dI%dI%dHIIHH' % (n, n, n)
+    data = vendor_in(dev, VENDOR_REQ_GET_PROFILE, 1 if args.reset else 0, struct.calcsize(fmt))
+    fields = struct.unpack(fmt, data)
+    counts, sums, maxs = fields[0:n], fields[n:2 * n], fields[2 * n:3 * n]
+    iterations, idle, loop_max, overruns = fields[3 * n:]
+
+    elapsed_us = counts[PROFILE_SOF] * 1000
+    print('%d ms profiled' % counts[PROFILE_SOF])
+    if not elapsed_us:
+        return
+    print('%-12s %10s %10s %10s %7s' % ('section', 'runs', 'avg cyc', 'max cyc', 'cpu %'))
+    for i, section in enumerate(PROFILE_SECTIONS):
+        avg = sums[i] // counts[i] if counts[i] else 0
+        print('%-12s %10d %10d %10d %7.2f' % (section, counts[i], avg, maxs[i],
+                                              100.0 * sums[i] / (CYCLES_PER_US * elapsed_us)))
+    print('main loop: %d iterations, %.1f%% idle, longest %d us' %
+          (iterations, 100.0 * idle / iterations if iterations else 0, loop_max))
+    print('frame overruns: %d' % overruns)
+
+def raw(dev, args):
+    usb.util.claim_interface(dev, RAW_INTERFACE)
+    vendor_out(dev, VENDOR_REQ_RAW_STREAM, 1)
+    samples = 0
+    try:
+        while args.count is None or samples < args.count:
+            packet = bytes(dev.read(RAW_EPADDR, 64, timeout=1000))
+            for i in range(0, len(packet), RAW_SAMPLE_SIZE):
+                stamp, panel, y, x, yd, xr, flags = decode_raw(packet[i:i + RAW_SAMPLE_SIZE])
+                print('%5d %d %4d %4d %4d %4d %s%s' % (stamp, panel, y, x, yd, xr,
+                                                      'T' if flags & 1 else '-',
+                                                      ' gap' if flags & 2 else ''))
+                samples += 1
+    except KeyboardInterrupt:
+        pass
+    finally:
+        vendor_out(dev, VENDOR_REQ_RAW_STREAM, 0)
+        enabled, overflows = struct.unpack('<BH', vendor_in(dev, VENDOR_REQ_RAW_STREAM, 1, 3))
+        print('%d samples, %d lost to overflows' % (samples, overflows), file=sys.stderr)
+
+def show_calibration(dev, panel):
+    m = CALIBRATION_MATRIX.unpack(vendor_in(dev, VENDOR_REQ_CALIBRATION, 0, CALIBRATION_MATRIX.size, panel))
+    scale = float(1 << CALIBRATION_FRAC_BITS)
+    print("X' = %9.4f * X + %9.4f * Y + %9.2f" % (m[0] / scale, m[1] / scale, m[2] / scale))
+    print("Y' = %9.4f * X + %9.4f * Y + %9.2f" % (m[3] / scale, m[4] / scale, m[5] / scale))
+
+def calibration(dev, args):
+    if args.action == 'reset':
+        vendor_out(dev, VENDOR_REQ_CALIBRATION, 0, index=args.panel)
+    show_calibration(dev, args.panel)
+
+def calibrate(dev, args):
+    for i, (fx, fy) in enumerate(CALIBRATION_TARGETS):
+        x, y = round(fx * args.logical_max), round(fy * args.logical_max)
+        input('touch and hold %.0f%% across, %.0f%% down (%d, %d), then press enter ' %
+              (100 * fx, 100 * fy, x, y))
+        # The device stalls the request while the panel is not pressed, and on the last point also
+        # when the points give no usable transform, which holding on won't fix
+        attempts = 0
+        while True:
+            try:
+                vendor_out(dev, VENDOR_REQ_CALIBRATE_POINT, i, struct.pack('<HH', x, y), args.panel)
+                break
+            except usb.core.USBError:
+                attempts += 1
+                if i == len(CALIBRATION_TARGETS) - 1 and attempts == 10:
+                    print('calibration rejected: no touch, or the points touched are collinear or '
+                          'out of range; the previous calibration stays in use')
+                    sys.exit(1)
+                print('  no touch, keep holding')
+                time.sleep(0.5)
+    show_calibration(dev, args.panel)
+
+def settle(dev, args):
+    if not args.show:
+        input('touch and hold the panel, then press enter ')
+        # The device stalls the request while the panel is not pressed
+        while True:
+            try:
+                vendor_out(dev, VENDOR_REQ_MEASURE_SETTLE, 0)
+                break
+            except usb.core.USBError:
+                print('  no touch, keep holding')
+                time.sleep(0.5)
+    while True:
+        fields = SETTLE_MEASUREMENT.unpack(vendor_in(dev, VENDOR_REQ_MEASURE_SETTLE, 0, SETTLE_MEASUREMENT.size))
+        if fields[0] != 1:
+            break
+        time.sleep(0.05)
+    print('measurement %s' % SETTLE_STATES[fields[0]])
+    if fields[0] == 0:
+        return
+    n = len(SCAN_PHASES)
+    for i, phase in enumerate(SCAN_PHASES):
+        curve = fields[1 + n + i * SETTLE_CURVE:1 + n + (i + 1) * SETTLE_CURVE]
+        print('%-8s settle %2d: %s' % (phase, fields[1 + i], ' '.join('%4d' % c for c in curve)))
+
+class BatchDecoder:
+    """Turns batched touch reports (firmware built with TOUCH_REPORT_BATCH) back into a stream of
+    (time in us, x, y, tip) events, timed by the scans rather than by the report polls. Pauses
+    longer than 65 ms between samples are shortened modulo 65536 us."""
+
+    def __init__(self):
+        self.sequence = None
+        self.time = 0
+        self.tip = False
+
+    def feed(self, report):
+        flags, _, x, y, _, _, _, sequence, count = REPORT_HEADER.unpack_from(report)
+        events = []
+        if sequence != self.sequence:
+            self.sequence = sequence
+            for i in range(count):
+                sx, sy, delta = REPORT_SAMPLE.unpack_from(report, REPORT_HEADER.size + i * REPORT_SAMPLE.size)
+                self.time += delta
+                events.append((self.time, sx, sy, True))
+        tip = bool(flags & REPORT_TIP)
+        if self.tip and not tip:
+            events.append((self.time, x, y, False))
+        self.tip = tip
+        return events
+
+def resample(events, rate):
+    """Linearly interpolates the pressed events of each stroke onto an even grid of rate Hz."""
+    period = 1e6 / rate
+    out, prev, grid = [], None, None
+    for event in events:
+        t, x, y, tip = event
+        if not tip:
+            out.append(event)
+            prev = grid = None
+            continue
+        if prev is None:
+            out.append(event)
+            grid = t + period
+        else:
+            pt, px, py, _ = prev
+            while grid <= t:
+                f = (grid - pt) / (t - pt) if t > pt else 1.0
+                out.append((grid, round(px + f * (x - px)), round(py + f * (y - py)), True))
+                grid += period
+        prev = event
+    return out
+
+def find_hidraw():
+    import pyudev
+    for device in pyudev.Context().list_devices(subsystem='hidraw'):
+        usb_device = device.find_parent('usb', 'usb_device')
+        if usb_device and usb_device.get('ID_VENDOR_ID') == '%04x' % VENDOR_ID and \
+                usb_device.get('ID_MODEL_ID') == '%04x' % PRODUCT_ID:
+            return device.device_node
+    return None
+
+def hidraw_ioctl(number, length):
+    """HIDIOCSFEATURE (0x06) and HIDIOCGFEATURE (0x07) for a buffer of length bytes."""
+    return (3 << 30) | (length << 16) | (ord('H') << 8) | number
+
+def get_settings(fd):
+    buf = bytearray([SETTINGS_REPORT_ID]) + bytearray(SETTINGS.size)
+    fcntl.ioctl(fd, hidraw_ioctl(0x07, len(buf)), buf)
+    return dict(zip(SETTINGS_FIELDS, SETTINGS.unpack_from(buf, 1)))
+
+def settings(args):
+    path = args.hidraw or find_hidraw()
+    if path is None:
+        print('no hidraw device found')
+        sys.exit(1)
+    fd = os.open(path, os.O_RDWR)
+    try:
+        values = get_settings(fd)
+        if args.assignments:
+            for assignment in args.assignments:
+                name, _, value = assignment.partition('=')
+                if name not in values:
+                    print('unknown setting %s, one of %s' % (name, ', '.join(SETTINGS_FIELDS)))
+                    sys.exit(1)
+                values[name] = int(value, 0)
+            buf = bytearray([SETTINGS_REPORT_ID]) + SETTINGS.pack(*(values[f] for f in SETTINGS_FIELDS))
+            fcntl.ioctl(fd, hidraw_ioctl(0x06, len(buf)), buf)
+            # The device ignores out of range settings, so read back what it took
+            if get_settings(fd) != values:
+                print('settings rejected as out of range')
+                values = get_settings(fd)
+        for name in SETTINGS_FIELDS:
+            print('%-20s %5d' % (name, values[name]))
+    finally:
+        os.close(fd)
+
+def batch(args):
+    path = args.hidraw or find_hidraw()
+    if path is None:
+        print('no hidraw device found')
+        sys.exit(1)
+    decoder = BatchDecoder()
+    fd = os.open(path, os.O_RDONLY)
+    try:
+        while True:
+            report = os.read(fd, 64)
+            if report[0] != TOUCH_REPORT_ID:
+                continue
+            events = decoder.feed(report[1:])
+            if args.rate:
+                events = resample(events, args.rate)
+            for t, x, y, tip in events:
+                print('%10.3f %5d %5d %s' % (t / 1000.0, x, y, 'down' if tip else 'up'), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(fd)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--serial', help='serial number of the device to query')
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('latency', help='end-to-end touch latency statistics')
+    p.add_argument('--reset', action='store_true', help='reset the statistics after reading them')
+    p.set_defaults(func=latency)
+    p = sub.add_parser('profile', help='CPU utilization profile (firmware built with TOUCH_PROFILE=1)')
+    p.add_argument('--reset', action='store_true', help='reset the profile after reading it')
+    p.set_defaults(func=profile)
+    p = sub.add_parser('raw', help='stream raw scan samples: timestamp Y X STBY_YD STBY_XR flags')
+    p.add_argument('--count', type=int, help='stop after this many samples')
+    p.set_defaults(func=raw)
+    p = sub.add_parser('batch', help='decode batched touch reports into scan timed events: ms X Y down/up')
+    p.add_argument('--hidraw', help='hidraw device node, found by vendor/product ID by default')
+    p.add_argument('--rate', type=float, help='resample the strokes evenly at this rate in Hz')
+    p.set_defaults(func=batch, local=True)
+    p = sub.add_parser('settings', help='show runtime settings, or change them with NAME=VALUE')
+    p.add_argument('--hidraw', help='hidraw device node, found by vendor/product ID by default')
+    p.add_argument('assignments', nargs='*', metavar='NAME=VALUE')
+    p.set_defaults(func=settings, local=True)
+    p = sub.add_parser('settle', help='measure the panel settle curves and switch to the settle times found')
+    p.add_argument('--show', action='store_true', help='show the latest measurement without measuring')
+    p.set_defaults(func=settle)
+    p = sub.add_parser('calibrate', help='calibrate interactively by touching three points')
+    p.add_argument('--logical-max', type=int, default=1023,
+                   help='largest reported coordinate, (1 << TOUCH_RESOLUTION_BITS) - 1')
+    p.add_argument('--panel', type=int, default=0, help='panel to calibrate on a multi-panel device')
+    p.set_defaults(func=calibrate)
+    p = sub.add_parser('calibration', help='show the calibration in use, or reset it to identity')
+    p.add_argument('action', nargs='?', choices=('show', 'reset'), default='show')
+    p.add_argument('--panel', type=int, default=0, help='panel to show or reset on a multi-panel device')
+    p.set_defaults(func=calibration)
+    args = parser.parse_args()
+
+    if getattr(args, 'local', False):
+        args.func(args)
+        return
+
+    kwargs = {'serial_number': args.serial} if args.serial else {}
+    dev = usb.core.find(idVendor=VENDOR_ID, idProduct=PRODUCT_ID, **kwargs)
+    if dev is None:
+        print('device not found')
+        sys.exit(1)
+
+    args.func(dev, args)
+
+if __name__ == '__main__':
+    main()
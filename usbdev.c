@@ -38,34 +38,52 @@
 #include "usbdev.h"
 #include "enter_bootloader.h"
 
+/** Previous touch report of every panel, for the HID class driver's idle comparison. */
+static uint8_t PrevMouseHIDReportBuffer[TOUCH_PANELS][sizeof(USB_TouchReport_Data_t)];
 
-typedef struct
-{
-	uint8_t Button; /**< Button mask for currently pressed buttons in the mouse. */
-	int16_t  X; /**< Current delta X movement of the mouse. */
-	int16_t  Y; /**< Current delta Y movement on the mouse. */
-} ATTR_PACKED USB_MouseReport16_Data_t;
+/** Set while the HID class driver processes a control request, whose input reports go out on the
+ *  control endpoint rather than the panel's IN endpoint.
+ */
+static bool InControlRequest;
 
-static uint8_t PrevMouseHIDReportBuffer[sizeof(USB_MouseReport16_Data_t)];
+_Static_assert(1 + sizeof(USB_TouchReport_Data_t) <= MOUSE_EPSIZE, "MOUSE_EPSIZE is too small for the touch report");
 
-/** LUFA HID Class driver interface configuration and state information. This structure is
- *  passed to all HID Class driver functions, so that multiple instances of the same class
- *  within a device can be differentiated from one another.
+/** LUFA HID Class driver interface configuration and state information, one HID interface per
+ *  panel. This structure is passed to all HID Class driver functions, so that multiple instances
+ *  of the same class within a device can be differentiated from one another.
  */
-USB_ClassInfo_HID_Device_t Mouse_HID_Interface =
+USB_ClassInfo_HID_Device_t Mouse_HID_Interface[TOUCH_PANELS] =
 	{
-		.Config =
-			{
-				.InterfaceNumber              = 0,
-				.ReportINEndpoint             =
-					{
-						.Address              = MOUSE_EPADDR,
-						.Size                 = MOUSE_EPSIZE,
-						.Banks                = 1,
-					},
-				.PrevReportINBuffer           = PrevMouseHIDReportBuffer,
-				.PrevReportINBufferSize       = sizeof(PrevMouseHIDReportBuffer),
-			},
+		{
+			.Config =
+				{
+					.InterfaceNumber              = 0,
+					.ReportINEndpoint             =
+						{
+							.Address              = MOUSE_EPADDR,
+							.Size                 = MOUSE_EPSIZE,
+							.Banks                = MOUSE_EPBANKS,
+						},
+					.PrevReportINBuffer           = PrevMouseHIDReportBuffer[0],
+					.PrevReportINBufferSize       = sizeof(PrevMouseHIDReportBuffer[0]),
+				},
+		},
+#if (TOUCH_PANELS > 1)
+		{
+			.Config =
+				{
+					.InterfaceNumber              = PANEL1_INTERFACE,
+					.ReportINEndpoint             =
+						{
+							.Address              = PANEL1_EPADDR,
+							.Size                 = MOUSE_EPSIZE,
+							.Banks                = MOUSE_EPBANKS,
+						},
+					.PrevReportINBuffer           = PrevMouseHIDReportBuffer[1],
+					.PrevReportINBufferSize       = sizeof(PrevMouseHIDReportBuffer[1]),
+				},
+		},
+#endif
 	};
 
 /** Main program entry point. This routine contains the overall program flow, including initial
@@ -79,11 +97,123 @@ int main(void)
 
 	for (;;)
 	{
-		HID_Device_USBTask(&Mouse_HID_Interface);
+		if (USB_DeviceState == DEVICE_STATE_Suspended)
+		{
+			Suspend_Task();
+			continue;
+		}
+
+		uint16_t LoopStart  = Profile_LoopBegin();
+		uint16_t TouchStart = Profile_Begin();
+		bool     NewFrame   = Touch_Task();
+
+		if (NewFrame)
+		  Profile_End(PROFILE_SECTION_TOUCH_TASK, TouchStart);
+
+		uint16_t HIDStart = Profile_Begin();
+		for (uint8_t Panel = 0; Panel < TOUCH_PANELS; Panel++)
+		  HID_Device_USBTask(&Mouse_HID_Interface[Panel]);
+		Profile_End(PROFILE_SECTION_HID_TASK, HIDStart);
+
+#if TOUCH_LATENCY_STATS
+		for (uint8_t Panel = 0; Panel < TOUCH_PANELS; Panel++)
+		{
+			Endpoint_SelectEndpoint(Mouse_HID_Interface[Panel].Config.ReportINEndpoint.Address);
+			Latency_EndpointPolled(Panel, Endpoint_GetBusyBanks());
+		}
+#endif
+		Settings_Task();
+		Calibration_Task();
+		Update_Task();
+#if TOUCH_RAW_STREAM
+		RawStream_USBTask();
+#endif
 		USB_USBTask();
+
+		Profile_LoopIteration(NewFrame, LoopStart);
+#if POWER_IDLE_SLEEP
+		Idle_Sleep();
+#endif
 	}
 }
 
+#if POWER_IDLE_SLEEP
+/** Halts the CPU until the next interrupt, unless a scan frame is already waiting. Once configured
+ *  the bus raises a start of frame interrupt every millisecond, so control requests, which are
+ *  polled by USB_USBTask(), still get served within a frame; during enumeration the loop keeps
+ *  polling, as an idle scan engine raises no interrupts at all.
+ */
+void Idle_Sleep(void)
+{
+	if (USB_DeviceState != DEVICE_STATE_Configured)
+	  return;
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
+	/* Interrupts stay off from the check to the sleep instruction, which runs before any
+	 * interrupt pending by then, so no wakeup can slip in between */
+	cli();
+	if (!(Touch_FramePending()))
+	{
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+#endif
+
+/** Watchdog ISR, only waking the CPU from power down to check the panel during suspend. */
+EMPTY_INTERRUPT(WDT_vect);
+
+/** Powers down while the bus is suspended, with the panel drive off and the scan engine stopped.
+ *  The USB controller wakes the CPU when the host resumes the bus. With remote wakeup enabled by
+ *  the host, the watchdog also wakes it periodically to check the panel, and a touch signals
+ *  remote wakeup, after which the CPU idles until the host drives the resume.
+ */
+void Suspend_Task(void)
+{
+	bool WakeupSent = false;
+
+	Touch_Suspend();
+
+#if POWER_REMOTE_WAKEUP
+	if (USB_Device_RemoteWakeupEnabled)
+	{
+		wdt_reset();
+		WDTCSR = _BV(WDCE) | _BV(WDE);
+		WDTCSR = _BV(WDIE) | (POWER_SUSPEND_POLL_WDTO & 0x07) | ((POWER_SUSPEND_POLL_WDTO & 0x08) ? _BV(WDP3) : 0);
+	}
+#endif
+
+	while (USB_DeviceState == DEVICE_STATE_Suspended)
+	{
+#if POWER_REMOTE_WAKEUP
+		if (!WakeupSent && USB_Device_RemoteWakeupEnabled && Touch_Detected())
+		{
+			USB_Device_SendRemoteWakeup();
+			WakeupSent = true;
+		}
+#endif
+
+		set_sleep_mode(WakeupSent ? SLEEP_MODE_IDLE : SLEEP_MODE_PWR_DOWN);
+
+		cli();
+		if (USB_DeviceState == DEVICE_STATE_Suspended)
+		{
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
+	}
+
+	wdt_disable();
+	Touch_Resume();
+}
+
 /** Configures the board hardware and chip peripherals for the project's functionality. */
 void SetupHardware(void)
 {
@@ -100,10 +230,11 @@ void SetupHardware(void)
 	USB_Init();
 
 	/* Initialize Needed HW */
-	// Select Vref=AVcc
-	ADMUX = (1<<REFS0);
-	//set prescaller to 128 and enable ADC
-	ADCSRA = (1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0)|(1<<ADEN);
+	Settings_Init();
+	Calibration_Load();
+	Touch_Init();
+	Latency_Reset();
+	Profile_Init();
 }
 
 /** Event handler for the library USB Configuration Changed event. */
@@ -111,13 +242,78 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
 	bool ConfigSuccess = true;
 
-	ConfigSuccess &= HID_Device_ConfigureEndpoints(&Mouse_HID_Interface);
+	for (uint8_t Panel = 0; Panel < TOUCH_PANELS; Panel++)
+	{
+		ConfigSuccess &= HID_Device_ConfigureEndpoints(&Mouse_HID_Interface[Panel]);
+		Mouse_HID_Interface[Panel].State.IdleCount = MOUSE_IDLE_MS;
+	}
+#if TOUCH_RAW_STREAM
+	ConfigSuccess &= Endpoint_ConfigureEndpoint(RAW_EPADDR, EP_TYPE_BULK, RAW_EPSIZE, 2);
+#endif
+	RawStream_Stop();
 
 	USB_Device_EnableSOFEvents();
 
 }
 
 
+/** Answers a GET_REPORT request for a feature report of a panel interface. The HID class driver
+ *  would copy any report it gets from \ref CALLBACK_HID_Device_CreateHIDReport() into the input
+ *  report's idle comparison buffer, after which the next input report would be compared against
+ *  feature data, so feature reports are answered here instead.
+ *
+ *  \return Boolean \c true if the request was handled.
+ */
+static bool ProcessFeatureGetReport(void)
+{
+	if ((USB_ControlRequest.bmRequestType != (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE)) ||
+	    (USB_ControlRequest.bRequest != HID_REQ_GetReport) ||
+	    ((USB_ControlRequest.wValue >> 8) != (HID_REPORT_ITEM_Feature + 1)))
+	{
+		return false;
+	}
+
+	bool PanelInterface = false;
+
+	for (uint8_t Panel = 0; Panel < TOUCH_PANELS; Panel++)
+	  PanelInterface |= (USB_ControlRequest.wIndex == Mouse_HID_Interface[Panel].Config.InterfaceNumber);
+
+	if (!PanelInterface)
+	  return false;
+
+	union
+	{
+		Settings_t         Settings;
+		USB_UpdateReport_t Update;
+		uint8_t            ContactCountMaximum;
+	} Report;
+	uint8_t  ReportID = (USB_ControlRequest.wValue & 0xFF);
+	uint16_t ReportSize;
+
+	switch (ReportID)
+	{
+		case SETTINGS_REPORT_ID:
+			Report.Settings = *Settings_GetRequested();
+			ReportSize = sizeof(Settings_t);
+			break;
+		case UPDATE_REPORT_ID:
+			Update_CreateReport(&Report.Update);
+			ReportSize = sizeof(USB_UpdateReport_t);
+			break;
+		default:
+			ReportID = TOUCH_REPORT_ID;
+			Report.ContactCountMaximum = 1;
+			ReportSize = 1;
+			break;
+	}
+
+	Endpoint_ClearSETUP();
+	Endpoint_Write_8(ReportID);
+	Endpoint_Write_Control_Stream_LE(&Report, ReportSize);
+	Endpoint_ClearOUT();
+	return true;
+}
+
 /** Event handler for the library USB Control Request reception event. */
 void EVENT_USB_Device_ControlRequest(void)
 {
@@ -131,148 +327,189 @@ void EVENT_USB_Device_ControlRequest(void)
 		{
 			switch(USB_ControlRequest.bRequest)
 			{
-				case 0x01:
+				case VENDOR_REQ_ENTER_BOOTLOADER:
 					Endpoint_ClearSETUP();
 					Endpoint_ClearStatusStage();
-					USB_USBTask();
-					Delay_MS(200);	
+					Update_RequestBootloader();
+					break;
+#if TOUCH_RAW_STREAM
+				case VENDOR_REQ_RAW_STREAM:
+					Endpoint_ClearSETUP();
+					Endpoint_ClearStatusStage();
+
+					if (USB_ControlRequest.wValue)
+						RawStream_Start();
+					else
+						RawStream_Stop();
+					break;
+#endif
+#if TOUCH_CALIBRATION
+				case VENDOR_REQ_CALIBRATION:
+					/* The panel is given in wIndex; others are left unhandled, and so stalled */
+					if (USB_ControlRequest.wIndex >= TOUCH_PANELS)
+					  break;
+
+					if (USB_ControlRequest.wLength == 0)
+					{
+						Endpoint_ClearSETUP();
+						Endpoint_ClearStatusStage();
+						Calibration_Reset(USB_ControlRequest.wIndex);
+					}
+					else if (USB_ControlRequest.wLength == sizeof(Calibration_Matrix_t))
+					{
+						Calibration_Matrix_t Calibration;
+
+						Endpoint_ClearSETUP();
+						Endpoint_Read_Control_Stream_LE(&Calibration, sizeof(Calibration));
+
+						/* A rejected transform stalls the status stage */
+						if (Calibration_Set(USB_ControlRequest.wIndex, &Calibration))
+						  Endpoint_ClearIN();
+						else
+						  Endpoint_StallTransaction();
+					}
+					break;
+				case VENDOR_REQ_CALIBRATE_POINT:
+				{
+					Calibration_Point_t Target;
+					uint16_t            X, Y;
+
+					/* Left unhandled, and so stalled, for a point index out of range or when there is no touch to
+					 * record on the panel in wIndex */
+					if ((USB_ControlRequest.wLength != sizeof(Target)) || (USB_ControlRequest.wIndex >= TOUCH_PANELS) ||
+					    (USB_ControlRequest.wValue >= CALIBRATION_POINTS) ||
+					    !(Touch_GetUncalibrated(USB_ControlRequest.wIndex, &X, &Y)))
+					  break;
+
+					Endpoint_ClearSETUP();
+					Endpoint_Read_Control_Stream_LE(&Target, sizeof(Target));
 
-					enter_bootloader();
+					/* Points giving no usable transform stall the status stage, keeping the old one */
+					if (Calibration_SetPoint(USB_ControlRequest.wIndex, USB_ControlRequest.wValue, X, Y, &Target))
+					  Endpoint_ClearIN();
+					else
+					  Endpoint_StallTransaction();
 					break;
+				}
+#endif
+#if TOUCH_SETTLE_MEASURE
+				case VENDOR_REQ_MEASURE_SETTLE:
+					/* Left unhandled, and so stalled, when there is no touch to measure */
+					if (!(Touch_MeasureSettle()))
+					  break;
+
+					Endpoint_ClearSETUP();
+					Endpoint_ClearStatusStage();
+					break;
+#endif
 			}
 		}
 		else
 		{
 			switch(USB_ControlRequest.bRequest)
 			{
+#if TOUCH_LATENCY_STATS
+				case VENDOR_REQ_GET_LATENCY:
+					Endpoint_ClearSETUP();
+					Endpoint_Write_Control_Stream_LE(Latency_GetStats(),
+					                                 MIN(sizeof(Latency_Stats_t), USB_ControlRequest.wLength));
+					Endpoint_ClearOUT();
+
+					if (USB_ControlRequest.wValue == 1)
+						Latency_Reset();
+					break;
+#endif
+#if TOUCH_PROFILE
+				case VENDOR_REQ_GET_PROFILE:
+					Endpoint_ClearSETUP();
+					Endpoint_Write_Control_Stream_LE(Profile_GetStats(),
+					                                 MIN(sizeof(Profile_Stats_t), USB_ControlRequest.wLength));
+					Endpoint_ClearOUT();
+
+					if (USB_ControlRequest.wValue == 1)
+						Profile_Reset();
+					break;
+#endif
+#if TOUCH_RAW_STREAM
+				case VENDOR_REQ_RAW_STREAM:
+					Endpoint_ClearSETUP();
+					Endpoint_Write_Control_Stream_LE(RawStream_GetStatus(USB_ControlRequest.wValue == 1),
+					                                 MIN(sizeof(RawStream_Status_t), USB_ControlRequest.wLength));
+					Endpoint_ClearOUT();
+					break;
+#endif
+#if TOUCH_CALIBRATION
+				case VENDOR_REQ_CALIBRATION:
+					if (USB_ControlRequest.wIndex >= TOUCH_PANELS)
+					  break;
+
+					Endpoint_ClearSETUP();
+					Endpoint_Write_Control_Stream_LE(Calibration_Get(USB_ControlRequest.wIndex),
+					                                 MIN(sizeof(Calibration_Matrix_t), USB_ControlRequest.wLength));
+					Endpoint_ClearOUT();
+					break;
+#endif
+#if TOUCH_SETTLE_MEASURE
+				case VENDOR_REQ_MEASURE_SETTLE:
+					Endpoint_ClearSETUP();
+					Endpoint_Write_Control_Stream_LE(Touch_GetSettleMeasurement(),
+					                                 MIN(sizeof(Touch_SettleMeasurement_t), USB_ControlRequest.wLength));
+					Endpoint_ClearOUT();
+					break;
+#endif
 			}
 		}
 	}
-	else
+	else if (!(ProcessFeatureGetReport()))
 	{
-		HID_Device_ProcessControlRequest(&Mouse_HID_Interface);
+		InControlRequest = true;
+		for (uint8_t Panel = 0; Panel < TOUCH_PANELS; Panel++)
+		  HID_Device_ProcessControlRequest(&Mouse_HID_Interface[Panel]);
+		InControlRequest = false;
 	}
 }
 
-enum AdcState {
-	ADC_STATE_STBY_SET,
-	ADC_STATE_STBY_INIT_READ,
-	ADC_STATE_STBY_READ_YD,
-	ADC_STATE_STBY_READ_XR,
-	ADC_STATE_Y_INIT_READ,
-	ADC_STATE_Y_READ,
-	ADC_STATE_X_INIT_READ,
-	ADC_STATE_X_READ,
-};
-
-#define PIN_YU 7
-#define PIN_XL 4
-#define PIN_YD 5
-#define PIN_XR 6
-
-static void InitADC(uint8_t ADCchannel)
+/** Event handler for the USB device Start Of Frame event. */
+void EVENT_USB_Device_StartOfFrame(void)
 {
-	//select ADC channel with safety mask
-	ADMUX = (ADMUX & 0xF0) | (ADCchannel & 0x0F);
-	//single conversion mode
-	ADCSRA |= (1<<ADSC);
-	DIDR0 = _BV(PIN_YU) | _BV(PIN_XL) | _BV(PIN_YD) | _BV(PIN_XR);
+	uint16_t Start = Profile_Begin();
+
+	for (uint8_t Panel = 0; Panel < TOUCH_PANELS; Panel++)
+	  HID_Device_MillisecondElapsed(&Mouse_HID_Interface[Panel]);
+	Touch_MillisecondElapsed();
+	RawStream_MillisecondElapsed();
+
+	Profile_End(PROFILE_SECTION_SOF, Start);
 }
 
-static uint8_t ReadADC(uint16_t *readout)
+#if TOUCH_RAW_STREAM
+/** Sends the next due packet of the raw sample stream once the bulk IN endpoint has a free bank. */
+void RawStream_USBTask(void)
 {
-	if(ADCSRA & (1<<ADSC))
-		return 0;
-	*readout = ADC;
-	return 1;
-}
+	if (USB_DeviceState != DEVICE_STATE_Configured)
+	  return;
 
-static struct {
-	uint16_t STBY_YD;
-	uint16_t STBY_XR;
-	uint16_t Y;
-	uint16_t X;
-	uint8_t full_update;
-} touch_internals;
+	Endpoint_SelectEndpoint(RAW_EPADDR);
+	if (!Endpoint_IsINReady())
+	  return;
 
-static struct {
-	uint16_t Y;
-	uint16_t X;
-	uint8_t pressed;
-} touch_vals;
+	uint8_t Packet[RAW_STREAM_PACKET_SAMPLES * RAW_STREAM_SAMPLE_SIZE];
+	uint8_t Length = RawStream_ReadPacket(Packet);
 
-/** Event handler for the USB device Start Of Frame event. */
-void EVENT_USB_Device_StartOfFrame(void)
-{
-	HID_Device_MillisecondElapsed(&Mouse_HID_Interface);
-	static enum AdcState adc_state = ADC_STATE_Y_INIT_READ;
-	switch(adc_state)
+	if (Length)
 	{
-	case ADC_STATE_STBY_SET:
-		PORTF = _BV(PIN_YU);
-		DDRF = _BV(PIN_YU) | _BV(PIN_XL);
-		adc_state = ADC_STATE_STBY_INIT_READ;
-		break;
-	case ADC_STATE_STBY_INIT_READ:
-		InitADC(PIN_YD);
-		adc_state = ADC_STATE_STBY_READ_YD;
-		break;
-	case ADC_STATE_STBY_READ_YD:
-		if(!ReadADC(&touch_internals.STBY_YD))
-			break;
-		InitADC(PIN_XR);
-		adc_state = ADC_STATE_STBY_READ_XR;
-		break;
-	case ADC_STATE_STBY_READ_XR:
-		if(!ReadADC(&touch_internals.STBY_XR))
-			break;
-		//calculations
-
-		if((((uint32_t)touch_internals.X * touch_internals.STBY_YD / touch_internals.STBY_XR) - touch_internals.X) > 500UL)
-		{
-			touch_vals.pressed = 0;
-			touch_internals.full_update = 0;
-		}
-		else
-		{
-			if(touch_internals.full_update)
-			{
-				touch_vals.X = touch_internals.X;
-				touch_vals.Y = touch_internals.Y;
-				touch_vals.pressed = 1;
-			}
-			touch_internals.full_update = 1;
-		}
-		PORTF = _BV(PIN_YU);
-		DDRF = _BV(PIN_YU) | _BV(PIN_YD);
-		adc_state = ADC_STATE_Y_INIT_READ;
-		break;
-	case ADC_STATE_Y_INIT_READ:
-		InitADC(PIN_XL);
-		adc_state = ADC_STATE_Y_READ;
-	case ADC_STATE_Y_READ:
-		if(!ReadADC(&touch_internals.Y))
-			break;
-		PORTF = _BV(PIN_XR);
-		DDRF = _BV(PIN_XR) | _BV(PIN_XL);
-		adc_state = ADC_STATE_X_INIT_READ;
-		break;
-	case ADC_STATE_X_INIT_READ:
-		InitADC(PIN_YU);
-		adc_state = ADC_STATE_X_READ;
-	case ADC_STATE_X_READ:
-		if(!ReadADC(&touch_internals.X))
-			break;
-		adc_state = ADC_STATE_STBY_SET;
-		break;
+		Endpoint_Write_Stream_LE(Packet, Length, NULL);
+		Endpoint_ClearIN();
 	}
 }
+#endif
 
 /** HID class driver callback function for the creation of HID reports to the host.
  *
  *  \param[in]     HIDInterfaceInfo  Pointer to the HID class interface configuration structure being referenced
  *  \param[in,out] ReportID    Report ID requested by the host if non-zero, otherwise callback should set to the generated report ID
- *  \param[in]     ReportType  Type of the report to create, either HID_REPORT_ITEM_In or HID_REPORT_ITEM_Feature
+ *  \param[in]     ReportType  Type of the report to create, always HID_REPORT_ITEM_In as feature reports are
+ *                             answered by \ref ProcessFeatureGetReport()
  *  \param[out]    ReportData  Pointer to a buffer where the created report should be stored
  *  \param[out]    ReportSize  Number of bytes written in the report (or zero if no report is to be sent)
  *
@@ -284,15 +521,14 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
                                          void* ReportData,
                                          uint16_t* const ReportSize)
 {
-	USB_MouseReport16_Data_t* MouseReport = (USB_MouseReport16_Data_t*)ReportData;
+	(void)ReportType;
 
-	MouseReport->Y = touch_vals.Y;
-	MouseReport->X = touch_vals.X;
+	*ReportID = TOUCH_REPORT_ID;
+	bool ForceSend = Touch_CreateReport(HIDInterfaceInfo - Mouse_HID_Interface, (USB_TouchReport_Data_t*)ReportData,
+	                                    !InControlRequest);
 
-	MouseReport->Button = touch_vals.pressed;
-
-	*ReportSize = sizeof(USB_MouseReport16_Data_t);
-	return true;
+	*ReportSize = sizeof(USB_TouchReport_Data_t);
+	return ForceSend;
 }
 
 /** HID class driver callback function for the processing of HID reports from the host.
@@ -309,5 +545,15 @@ void CALLBACK_HID_Device_ProcessHIDReport(USB_ClassInfo_HID_Device_t* const HIDI
                                           const void* ReportData,
                                           const uint16_t ReportSize)
 {
-	// Unused (but mandatory for the HID class driver) in this demo, since there are no Host->Device reports
+	/* Out of range settings are ignored; the host reads the feature report back to check */
+	if ((ReportType == HID_REPORT_ITEM_Feature) && (ReportID == SETTINGS_REPORT_ID) &&
+	    (ReportSize == sizeof(Settings_t)))
+	{
+		Settings_Request((const Settings_t*)ReportData);
+	}
+	else if ((ReportType == HID_REPORT_ITEM_Feature) && (ReportID == UPDATE_REPORT_ID) &&
+	         (ReportSize == sizeof(USB_UpdateReport_t)))
+	{
+		Update_ProcessReport((const USB_UpdateReport_t*)ReportData);
+	}
 }
@@ -41,18 +41,51 @@
 		#include <avr/io.h>
 		#include <avr/wdt.h>
 		#include <avr/power.h>
+		#include <avr/sleep.h>
 		#include <avr/interrupt.h>
 
 		#include "Descriptors.h"
+		#include "touch.h"
 
 		#include <LUFA/Drivers/Board/LEDs.h>
 		#include <LUFA/Drivers/USB/USB.h>
 		#include <LUFA/Platform/Platform.h>
 
+	/* Enums: */
+		/** Vendor specific control requests, addressed to the device. */
+		enum VendorRequests_t
+		{
+			VENDOR_REQ_ENTER_BOOTLOADER = 0x01, /**< Host to device: reboot into the bootloader. */
+			VENDOR_REQ_GET_LATENCY      = 0x02, /**< Device to host: latency statistics, reset after
+			                                     *   reading if wValue is 1. */
+			VENDOR_REQ_GET_PROFILE      = 0x03, /**< Device to host: CPU profile, reset after reading
+			                                     *   if wValue is 1. */
+			VENDOR_REQ_RAW_STREAM       = 0x04, /**< Host to device: start the raw sample stream if wValue
+			                                     *   is non-zero, stop it otherwise. Device to host: raw
+			                                     *   stream status, overflow count reset if wValue is 1. */
+			VENDOR_REQ_CALIBRATION      = 0x05, /**< Host to device: store the calibration matrix sent as
+			                                     *   data, or restore identity if there is none. Device to
+			                                     *   host: the calibration matrix in use. */
+			VENDOR_REQ_CALIBRATE_POINT  = 0x06, /**< Host to device: record the current touch as reference
+			                                     *   point wValue, sent the target coordinates as data.
+			                                     *   Stalls if the panel is not pressed. */
+			VENDOR_REQ_MEASURE_SETTLE   = 0x07, /**< Host to device: measure the panel's settle curves and
+			                                     *   switch to the settle times found. Stalls if the panel
+			                                     *   is not pressed. Device to host: the latest settle
+			                                     *   measurement. */
+		};
+
 	/* Macros: */
 
 	/* Function Prototypes: */
 		void SetupHardware(void);
+		void Suspend_Task(void);
+		#if POWER_IDLE_SLEEP
+		void Idle_Sleep(void);
+		#endif
+		#if TOUCH_RAW_STREAM
+		void RawStream_USBTask(void);
+		#endif
 
 		void EVENT_USB_Device_ConfigurationChanged(void);
 		void EVENT_USB_Device_ControlRequest(void);